@@ -10,6 +10,25 @@
 #include <random>
 #include <utility>
 #include <cctype>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+#include <fstream>
+#include <iomanip>
+#include <cmath>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <cerrno>
+#include <cstdio>
 using namespace std;
 
 
@@ -37,6 +56,11 @@ const int NONE = 4;
 const int HORIZONTAL = 0;
 const int VERTICAL = 1;
 
+const int WATER = 0;
+const int STRUCK = 1;
+const int SANK = 2;
+const int WASTED = 3;
+
 const int SPACE = 20;
 
 const int NORTH = 0;
@@ -44,6 +68,32 @@ const int EAST = 1;
 const int SOUTH = 2;
 const int WEST = 3;
 
+const int DEFAULTBUDGET = 2000;  // microseconds per enemy move
+const int PONDERLIMIT = 1000000;  // microseconds of thinking while the player types, unless the budget is longer
+
+const int TILESIZE = 16;
+const int MAXLARGE = 100000;
+const int WINDOW = 10;
+
+const int RECORDCHUNK = 4096;
+const int BASELINEGAMES = 200000;
+const int PRIORSTRENGTH = 20;  // pseudo-games of random layouts mixed into the learned priors
+const int PRIORONE = 256;  // 1.0 in the 8.8 fixed-point prior table
+const int EVALSAMPLES = 200;  // layouts per shot when -evaluate is not given -samples
+
+const int MAXPLAYERS = 64;
+const int FFAGAMES = 2000;  // fleet-rounds per benchmark size, spread over fewer games as fleets grow
+
+const int CHECKPOINTGAMES = 10000;
+const int MAXRESTARTS = 3;
+const int SHARDLOCKED = 2;  // exit status of a worker whose shard another process is still writing
+
+const int FEEDWORDS = (2 * MAXROWS * MAXCOLS + 7) / 8;
+const int FEEDFRAMES = 10000;
+const int FEEDINTERVAL = 100;  // microseconds between turns in the feed benchmark
+const int PLACEMENTTRIES = 50;
+const int HUNTTRIES = 1000;
+
 ///////////////////////////////////////////////////////////////////////////
 // Type definitions
 ///////////////////////////////////////////////////////////////////////////
@@ -51,6 +101,10 @@ const int WEST = 3;
 
 class Grid;
 
+struct PriorTable {
+    unsigned short weight[MAXSHIPS][2][MAXROWS][MAXCOLS];  // odds of each placement relative to a random layout
+};
+
 class Ship {
 public:
       // Constructor
@@ -89,6 +143,8 @@ public:
     int numShips() const;
     bool isOpponent() const;
     int getCellStatus(int row, int col) const;
+    bool isSunk(int row, int col) const;
+    Ship* getShip(int i) const;
     
       // Mutators
     void addShip(string name, string coord, int orientation, int length);
@@ -99,6 +155,7 @@ public:
     
 private:
     int m_grid[MAXROWS][MAXCOLS];
+    bool m_sunk[MAXROWS][MAXCOLS];
     int m_rows;
     int m_cols;
     int m_numShips;
@@ -109,6 +166,196 @@ private:
     
 };
 
+class Targeter {
+public:
+      // Constructor
+    Targeter(const Grid* g, const PriorTable* priors = nullptr);
+    
+      // Accessors
+    void bestTarget(int& row, int& col, default_random_engine* generator = nullptr) const;
+    
+      // Mutators
+    void run(chrono::steady_clock::time_point deadline, const atomic<bool>* cancel = nullptr);
+    void runSamples(long samples, default_random_engine& generator);
+    
+private:
+    int m_cells[MAXROWS][MAXCOLS];
+    bool m_sunk[MAXROWS][MAXCOLS];
+    int m_lengths[MAXSHIPS];
+    int m_types[MAXSHIPS];
+    int m_numShips;
+    const PriorTable* m_priors;
+    long m_counts[MAXROWS][MAXCOLS];
+    
+      // Helper functions
+    bool fits(const bool layout[MAXROWS][MAXCOLS], int row, int col, int length, int orientation) const;
+    long sampleLayout(default_random_engine& generator, bool layout[MAXROWS][MAXCOLS]) const;
+    void countLayout(default_random_engine& generator, long counts[MAXROWS][MAXCOLS]) const;
+    void sampleUntil(unsigned seed, chrono::steady_clock::time_point deadline, const atomic<bool>* cancel, long counts[MAXROWS][MAXCOLS]) const;
+};
+
+class HuntAI {
+public:
+      // Constructor
+    HuntAI(unsigned seed);
+    
+      // Mutators
+    void nextShot(const Grid* g, int& row, int& col);
+    void observe(const Grid* g, bool sankShip);
+    
+private:
+    default_random_engine m_generator;
+    int m_row;
+    int m_col;
+    bool m_findDirection;
+    int m_setDirection;
+    int m_dir;
+    
+      // Helper functions
+    int random(int lowest, int highest);
+    bool isTarget(const Grid* g, int row, int col) const;
+};
+
+class Ponderer {
+public:
+      // Constructor/destructor
+    Ponderer(Targeter* enemy, int budget);
+    ~Ponderer();
+    
+      // Mutators
+    void start();
+    void stop();
+    void finish();
+    
+private:
+    Targeter* m_enemy;
+    int m_budget;
+    atomic<bool> m_cancel;
+    thread m_thread;
+    chrono::steady_clock::time_point m_started;
+    
+      // Helper functions
+    void ponder();
+};
+
+struct GameRecord {
+    unsigned char shipRow[MAXSHIPS];  // player's layout, Destroyer through Carrier
+    unsigned char shipCol[MAXSHIPS];
+    unsigned char shipOrientation[MAXSHIPS];
+    unsigned char numShots;
+    unsigned char shots[MAXROWS * MAXCOLS];  // enemy shots as (row - 1) * MAXCOLS + col - 1
+};
+
+struct GameStats {
+    long games;
+    long firstHit[MAXROWS][MAXCOLS];
+    long occupancy[MAXROWS][MAXCOLS];
+    long placements[MAXSHIPS][2][MAXROWS][MAXCOLS];
+    long sinkShots[MAXSHIPS][MAXROWS * MAXCOLS + 1];
+};
+
+struct EvalStats {
+    long games;
+    long shots[2];  // shots to win without and with priors
+    long squares;  // sum of the squared per-game differences
+};
+
+struct FeedFrame {
+    atomic<unsigned long> sequence;  // odd while the writer is in the middle of a frame
+    atomic<unsigned long> turn;
+    atomic<unsigned long> fog;  // bit 0 for the player's board, bit 1 for the opponent's
+    atomic<unsigned long> closed;
+    atomic<unsigned long> cells[FEEDWORDS];  // both boards, one byte per cell
+};
+
+struct FeedSnapshot {
+    unsigned long turn;
+    unsigned long fog;
+    bool closed;
+    unsigned char cells[FEEDWORDS * 8];
+};
+
+struct FfaPlayer {
+    Grid* grid;
+    int cells[MAXROWS * MAXCOLS];  // cells of this grid in the order shooters will try them
+    int nextCell;
+    vector<int> leads;  // cells next to hits on this grid that have not been tried yet
+    bool human;
+    int eliminated;  // round the fleet was lost in, 0 while afloat
+};
+
+struct FfaShot {
+    int shooter;
+    int target;
+    int row;
+    int col;
+};
+
+struct FleetShip {
+    string name;
+    int row;
+    int col;
+    int orientation;
+    int length;
+    int damage;
+};
+
+class SparseGrid {
+public:
+      // Constructor/destructor
+    SparseGrid(int rows, int cols, bool isOpponent);
+    ~SparseGrid();
+    
+      // Accessors
+    int rows() const;
+    int cols() const;
+    int numShips() const;
+    bool isOpponent() const;
+    int getCellStatus(int row, int col) const;
+    long numTiles() const;
+    bool isValidShipPos(int row, int col, int length, int orientation) const;
+    
+      // Mutators
+    void addShip(string name, int row, int col, int orientation, int length);
+    FleetShip* hitShip(int row, int col);
+    void sinkShip(FleetShip* ship);
+    void setCellStatus(int row, int col, int status);
+    
+private:
+    struct Tile {
+        unsigned char cells[TILESIZE][TILESIZE];
+    };
+    
+    unordered_map<long long, Tile*> m_tiles;
+    unordered_map<long long, vector<FleetShip*>> m_index;
+    vector<FleetShip*> m_ships;
+    int m_rows;
+    int m_cols;
+    int m_numShips;
+    bool m_isOpponent;
+    
+      // Helper functions
+    long long tileKey(int row, int col) const;
+};
+
+
+class SpectatorFeed {
+public:
+      // Constructor/destructor
+    SpectatorFeed(string name);
+    ~SpectatorFeed();
+    
+      // Accessors
+    bool isOpen() const;
+    
+      // Mutators
+    void publish(const Grid* player, const Grid* opponent, int turn);
+    
+private:
+    string m_name;
+    FeedFrame* m_frame;
+};
+
 
 ///////////////////////////////////////////////////////////////////////////
 //  Auxiliary function declarations
@@ -125,7 +372,51 @@ char getLetter(int n);
 void printNums();
 void display(Grid* player, Grid* opponent);
 void addOppShips(Grid* g);
+void addLayout(Grid* g, const GameRecord& layout);
+int fire(Grid* g, int row, int col, string& shipName);
 void attack(Grid* g, int row, int col);
+int shipType(string name);
+void recordLayout(Grid* g, GameRecord& record);
+bool randomLayout(default_random_engine& generator, GameRecord& record);
+void randomBaseline(GameStats& stats, long games);
+bool appendRecord(string file, const GameRecord& record);
+void addGame(GameStats& stats, const GameRecord& record);
+void mergeStats(GameStats& total, const GameStats& part);
+void scanRange(string file, long first, long last, GameStats* stats);
+bool scanRecords(const vector<string>& files, GameStats& stats);
+void printCellTable(double table[MAXROWS][MAXCOLS], int precision);
+void analyzeRecords(const vector<string>& files);
+void trainPriors(string file, const vector<string>& records);
+bool loadPriors(string file, PriorTable& priors);
+string feedName(string name);
+const FeedFrame* openFeed(string name);
+bool readFrame(const FeedFrame* frame, FeedSnapshot& snapshot);
+void displayFrame(const FeedSnapshot& snapshot);
+void spectate(string name);
+void benchFeed(int numReaders);
+void chooseFfaShot(vector<FfaPlayer>& players, const vector<int>& alive, int shooter, default_random_engine& generator, FfaShot& shot);
+int resolveFfaRound(vector<FfaPlayer>& players, const vector<FfaShot>& shots, int round, bool verbose);
+void playFfa(int numPlayers, bool humanPlays, default_random_engine& generator, long& rounds, long& shotsFired, double& seconds);
+void benchFfa();
+void playLayout(default_random_engine& generator, long samples, const PriorTable* priors, GameRecord& record);
+void simulateGame(long seed, long samples, const PriorTable* priors, GameRecord& record);
+string shardFile(string dir, int shard, string extension);
+bool readCheckpoint(string file, long& next, long& bytes);
+bool writeCheckpoint(string file, long next, long bytes);
+bool writeAll(int fd, const char* data, long length);
+void runShard(string dir, int shard, long first, long last, long samples, const PriorTable* priors);
+bool readRun(string dir, long& games, int& workers, long& samples, int& usesPriors);
+long shardProgress(string dir, int shard, long games, int workers);
+void simulate(string dir, long games, int workers, long samples, const PriorTable* priors);
+void mergeShards(string dir);
+void evaluateRange(const vector<GameRecord>* layouts, long first, long last, long samples, const PriorTable* priors, EvalStats* stats);
+void evaluatePriors(string file, const vector<string>& records, long samples);
+string rowLabel(int n);
+bool parseLargeCoord(string coord, int rows, int cols, int& row, int& col);
+void addRandomFleet(SparseGrid* g, int numShips);
+void attackFleet(SparseGrid* g, int row, int col);
+void displayWindow(SparseGrid* g, int row, int col);
+void playFleetBattle(int rows, int cols, int numShips);
 
 
 ///////////////////////////////////////////////////////////////////////////
@@ -145,6 +436,7 @@ Grid::Grid(bool isOpponent) {
     for (int i = 0; i < m_rows; i++) {
         for (int j = 0; j < m_cols; j++) {
             m_grid[i][j] = EMPTY;
+            m_sunk[i][j] = false;
         }
     }
 }
@@ -175,6 +467,17 @@ int Grid::getCellStatus(int row, int col) const{
     return m_grid[row - 1][col - 1];
 }
 
+bool Grid::isSunk(int row, int col) const {
+    return m_sunk[row - 1][col - 1];
+}
+
+Ship* Grid::getShip(int i) const {
+    if (i < 0 || i >= m_numShips) {
+        return nullptr;
+    }
+    return m_ships[i];
+}
+
 
 void Grid::addShip(string name, string coord, int orientation, int length) {
     m_ships[m_numShips] = new Ship(this, name, coord, orientation, length);
@@ -216,9 +519,20 @@ Ship* Grid::hitShip(int row, int col) {
 void Grid::sinkShip(Ship* ship) {
     for (int i = 0; i < m_numShips; i++) {
         if (m_ships[i] == ship) {
+            int row = rowOfCoord(ship->coordinate());
+            int col = colOfCoord(ship->coordinate());
+            for (int j = 0; j < ship->length(); j++) {
+                if (ship->orientation() == HORIZONTAL) {
+                    m_sunk[row - 1][col - 1 + j] = true;
+                }
+                else {
+                    m_sunk[row - 1 + j][col - 1] = true;
+                }
+            }
             delete m_ships[i];
             m_ships[i] = m_ships[m_numShips - 1];
             m_numShips--;
+            m_ships[m_numShips] = nullptr;
         }
     }
 }
@@ -329,139 +643,741 @@ void Ship::setStatus(int row, int col, int status) {
 
 
 ///////////////////////////////////////////////////////////////////////////
-//  Auxiliary functions
+//  Targeter implementation
 ///////////////////////////////////////////////////////////////////////////
 
 
-int randInt(int lowest, int highest)
-{
-    if (highest < lowest)
-        swap(highest, lowest);
-    static random_device rd;
-    static default_random_engine generator(rd());
-    uniform_int_distribution<> distro(lowest, highest);
-    return distro(generator);
+Targeter::Targeter(const Grid* g, const PriorTable* priors) {
+    m_numShips = 0;
+    m_priors = priors;
+    
+      // Only what the shooter can see is copied: misses, hits and sunk ships
+    for (int i = 0; i < MAXROWS; i++) {
+        for (int j = 0; j < MAXCOLS; j++) {
+            int status = g->getCellStatus(i + 1, j + 1);
+            m_cells[i][j] = (status == HIT || status == DAMAGED) ? status : EMPTY;
+            m_sunk[i][j] = g->isSunk(i + 1, j + 1);
+            m_counts[i][j] = 0;
+        }
+    }
+    for (int i = 0; i < g->numShips(); i++) {
+        m_lengths[m_numShips] = g->getShip(i)->length();
+        m_types[m_numShips] = shipType(g->getShip(i)->name());
+        m_numShips++;
+    }
 }
 
-
-bool isValidCoord(string coord) {
-    if (coord.length() < 2 || coord.length() > 3 || !isalpha(coord.at(0)) || !isdigit(coord.at(1))) {
-        //cout << "Invalid coordinates" << endl;
-        return false;
+void Targeter::bestTarget(int& row, int& col, default_random_engine* generator) const {
+    long best = -1;
+    for (int i = 0; i < MAXROWS; i++) {
+        for (int j = 0; j < MAXCOLS; j++) {
+            if (m_cells[i][j] == EMPTY && m_counts[i][j] > best) {
+                best = m_counts[i][j];
+                row = i + 1;
+                col = j + 1;
+            }
+        }
     }
-    if (coord.at(0) == '#') {
-        return false;
+    if (best <= 0) {
+        do {
+            if (generator == nullptr) {
+                row = randInt(1, MAXROWS);
+                col = randInt(1, MAXCOLS);
+            }
+            else {
+                row = (*generator)() % MAXROWS + 1;
+                col = (*generator)() % MAXCOLS + 1;
+            }
+        } while (m_cells[row - 1][col - 1] != EMPTY && best != -1);
+    }
+}
+
+void Targeter::run(chrono::steady_clock::time_point deadline, const atomic<bool>* cancel) {
+    int numThreads = thread::hardware_concurrency();
+    if (numThreads < 1) {
+        numThreads = 1;
     }
     
-    char c = tolower(coord.at(0));
-    int num;
-    if (coord.length() == 2) {
-        num = coord.at(1) - 48;
+    random_device rd;
+    vector<thread> threads;
+    vector<long> counts(numThreads * MAXROWS * MAXCOLS, 0);
+    
+      // The calling thread does the last share of the work itself
+    for (int t = 0; t < numThreads; t++) {
+        long (*local)[MAXCOLS] = reinterpret_cast<long (*)[MAXCOLS]>(&counts[t * MAXROWS * MAXCOLS]);
+        if (t == numThreads - 1) {
+            sampleUntil(rd(), deadline, cancel, local);
+        }
+        else {
+            threads.push_back(thread(&Targeter::sampleUntil, this, rd(), deadline, cancel, local));
+        }
     }
-    else {
-        num = (coord.at(1) - 48)*10 + (coord.at(2) - 48);
+    for (size_t t = 0; t < threads.size(); t++) {
+        threads[t].join();
     }
     
-    if (c > 96 + MAXROWS || num <= 0 || num > MAXCOLS) {
-        //cout << "Invalid coordinates" << endl;
+    for (int t = 0; t < numThreads; t++) {
+        for (int i = 0; i < MAXROWS; i++) {
+            for (int j = 0; j < MAXCOLS; j++) {
+                m_counts[i][j] += counts[(t * MAXROWS + i) * MAXCOLS + j];
+            }
+        }
+    }
+}
+
+void Targeter::runSamples(long samples, default_random_engine& generator) {
+      // One thread and a fixed number of samples, so the same generator state always gives the same target
+    for (long n = 0; n < samples; n++) {
+        countLayout(generator, m_counts);
+    }
+}
+
+bool Targeter::fits(const bool layout[MAXROWS][MAXCOLS], int row, int col, int length, int orientation) const {
+    int endRow = row + (orientation == VERTICAL ? length - 1 : 0);
+    int endCol = col + (orientation == HORIZONTAL ? length - 1 : 0);
+    if (row < 0 || col < 0 || endRow >= MAXROWS || endCol >= MAXCOLS) {
         return false;
     }
     
+      // Same rule as isValidShipPos: nothing else may touch the ship, diagonals included
+    for (int i = row - 1; i <= endRow + 1; i++) {
+        for (int j = col - 1; j <= endCol + 1; j++) {
+            if (i < 0 || j < 0 || i >= MAXROWS || j >= MAXCOLS) {
+                continue;
+            }
+            bool onShip = i >= row && i <= endRow && j >= col && j <= endCol;
+            if (layout[i][j] || m_sunk[i][j] || (onShip && m_cells[i][j] == HIT) || (!onShip && m_cells[i][j] == DAMAGED)) {
+                return false;
+            }
+        }
+    }
     return true;
 }
 
-bool isValidShipPos(Grid* g, string coord, int length, int orientation) {
+long Targeter::sampleLayout(default_random_engine& generator, bool layout[MAXROWS][MAXCOLS]) const {
+    int order[MAXSHIPS];
+    for (int i = 0; i < m_numShips; i++) {
+        order[i] = i;
+    }
+    shuffle(order, order + m_numShips, generator);
+    long weight = PRIORONE;
     
-    if (orientation == HORIZONTAL) {
-        if (colOfCoord(coord) + length > MAXCOLS + 1) {
-            return false;
+    for (int i = 0; i < MAXROWS; i++) {
+        for (int j = 0; j < MAXCOLS; j++) {
+            layout[i][j] = false;
         }
-        for (int i = 0; i < length; i++) {
-            if (g->getCellStatus(rowOfCoord(coord), colOfCoord(coord) + i) != EMPTY) {
-                return false;
+    }
+    
+    for (int s = 0; s < m_numShips; s++) {
+        int length = m_lengths[order[s]];
+        int row = -1;
+        int col = -1;
+        int orientation = HORIZONTAL;
+        
+          // Ships go over uncovered hits first, otherwise those samples would almost all be rejected
+        int hitRow = -1;
+        int hitCol = -1;
+        for (int i = 0; i < MAXROWS && hitRow == -1; i++) {
+            for (int j = 0; j < MAXCOLS; j++) {
+                if (m_cells[i][j] == DAMAGED && !m_sunk[i][j] && !layout[i][j]) {
+                    hitRow = i;
+                    hitCol = j;
+                    break;
+                }
             }
         }
-        int num = -1;
-        while (num < 2) {
-            for (int j = colOfCoord(coord) - 1; j < colOfCoord(coord) + length + 1; j++) {
-                string newCoord = getLetter(rowOfCoord(coord) + num) + to_string(j);
-                if (!isValidCoord(newCoord)) {
-                    continue;
-                }
-                if (num == 0 && j >= colOfCoord(coord) && j < colOfCoord(coord) + length) {
-                    continue;
-                }
-                if (g->getCellStatus(rowOfCoord(coord) + num, j) != EMPTY) {
-                    return false;
-                }
+        
+        int tries = 0;
+        bool placed = false;
+        while (!placed && tries < PLACEMENTTRIES) {
+            orientation = generator() % 2;
+            if (hitRow != -1) {
+                int offset = generator() % length;
+                row = hitRow - (orientation == VERTICAL ? offset : 0);
+                col = hitCol - (orientation == HORIZONTAL ? offset : 0);
             }
-            num++;
+            else {
+                row = generator() % MAXROWS;
+                col = generator() % MAXCOLS;
+            }
+            placed = fits(layout, row, col, length, orientation);
+            tries++;
         }
-    }
-    if (orientation == VERTICAL) {
-        if (rowOfCoord(coord) + length > MAXROWS + 1) {
-            return false;
+        if (!placed) {
+            return 0;
+        }
+        if (m_priors != nullptr && m_types[order[s]] != -1) {
+            weight = max((weight * m_priors->weight[m_types[order[s]]][orientation][row][col]) / PRIORONE, 1L);
         }
+        
         for (int i = 0; i < length; i++) {
-            if (g->getCellStatus(rowOfCoord(coord) + i, colOfCoord(coord)) != EMPTY) {
-                return false;
+            if (orientation == HORIZONTAL) {
+                layout[row][col + i] = true;
             }
-        }
-        int num = -1;
-        while (num < 2) {
-            for (int j = rowOfCoord(coord) - 1; j < rowOfCoord(coord) + length + 1; j++) {
-                string newCoord = getLetter(j) + to_string(colOfCoord(coord) + num);
-                if (!isValidCoord(newCoord)) {
-                    continue;
-                }
-                if (num == 0 && j >= rowOfCoord(coord) && j < rowOfCoord(coord) + length) {
-                    continue;
-                }
-                if (g->getCellStatus(j, colOfCoord(coord) + num) != EMPTY) {
-                    return false;
-                }
+            else {
+                layout[row + i][col] = true;
             }
-            num++;
         }
     }
     
-    return true;
-}
-
-int decodeOrientation(string orientation) {
-    for (int i = 0; i < orientation.length(); i++) {
-        orientation.at(i) = tolower(orientation.at(i));
-    }
-    if (orientation == "h" || orientation == "horizontal") {
-        return HORIZONTAL;
-    }
-    if (orientation == "v" || orientation == "vertical") {
-        return VERTICAL;
+    for (int i = 0; i < MAXROWS; i++) {
+        for (int j = 0; j < MAXCOLS; j++) {
+            if (m_cells[i][j] == DAMAGED && !m_sunk[i][j] && !layout[i][j]) {
+                return 0;
+            }
+        }
     }
-    return -1;
+    return weight;
 }
 
-int rowOfCoord(string coord) {
-    if (!isValidCoord(coord)) {
-        return -1;
-    }
+void Targeter::sampleUntil(unsigned seed, chrono::steady_clock::time_point deadline, const atomic<bool>* cancel, long counts[MAXROWS][MAXCOLS]) const {
+    default_random_engine generator(seed);
     
-    char c = tolower(coord.at(0));
-    return c - 96;
-}
-
-int colOfCoord(string coord) {
-    if (!isValidCoord(coord)) {
-        return -1;
-    }
+      // Counted on this thread's stack and handed back once, so threads never write to a shared cache line
+    long local[MAXROWS][MAXCOLS] = {};
     
-    if (coord.length() == 2) {
-        return coord.at(1) - 48;
+    do {
+          // Samples are cheap, so the clock is only read once per batch
+        for (int n = 0; n < 64; n++) {
+            countLayout(generator, local);
+        }
+    } while (chrono::steady_clock::now() < deadline && (cancel == nullptr || !cancel->load()));
+    
+    for (int i = 0; i < MAXROWS; i++) {
+        for (int j = 0; j < MAXCOLS; j++) {
+            counts[i][j] = local[i][j];
+        }
     }
-    return (coord.at(1) - 48)*10 + (coord.at(2) - 48);
 }
 
-char getLetter(int n) {
+void Targeter::countLayout(default_random_engine& generator, long counts[MAXROWS][MAXCOLS]) const {
+    bool layout[MAXROWS][MAXCOLS];
+    long weight = sampleLayout(generator, layout);
+    if (weight == 0) {
+        return;
+    }
+    for (int i = 0; i < MAXROWS; i++) {
+        for (int j = 0; j < MAXCOLS; j++) {
+            if (layout[i][j] && m_cells[i][j] == EMPTY) {
+                counts[i][j] += weight;
+            }
+        }
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//  HuntAI implementation
+///////////////////////////////////////////////////////////////////////////
+
+
+HuntAI::HuntAI(unsigned seed) : m_generator(seed) {
+    m_row = 0;
+    m_col = 0;
+    m_findDirection = false;
+    m_setDirection = -1;
+    m_dir = -1;
+}
+
+void HuntAI::nextShot(const Grid* g, int& row, int& col) {
+    int tempRow = m_row;
+    int tempCol = m_col;
+    int tries = 0;
+    
+    if (m_setDirection != -1) {
+        do {
+            switch (m_setDirection) {
+                case NORTH: m_row--; break;
+                case EAST: m_col++; break;
+                case SOUTH: m_row++; break;
+                case WEST: m_col--; break;
+                default: cout << "Problem when setDirection != -1" << endl; break;
+            }
+            
+            if (m_row < 1 || m_row > MAXROWS || m_col < 1 || m_col > MAXCOLS || g->getCellStatus(m_row, m_col) == HIT) {
+                switch (m_setDirection) {
+                    case NORTH: m_setDirection = SOUTH; m_row++; break;
+                    case EAST: m_setDirection = WEST; m_col--; break;
+                    case SOUTH: m_setDirection = NORTH; m_row--; break;
+                    case WEST: m_setDirection = EAST; m_col++; break;
+                    default: cout << "Problem when not valid and hit" << endl; break;
+                }
+            }
+        } while (!isTarget(g, m_row, m_col) && ++tries < HUNTTRIES);
+    }
+    else if (m_findDirection) {
+        do {
+            int n = random(1, 4);
+            m_row = tempRow;
+            m_col = tempCol;
+            
+            switch (n) {
+                case 1: m_dir = NORTH; m_row--; break;
+                case 2: m_dir = EAST; m_col++; break;
+                case 3: m_dir = SOUTH; m_row++; break;
+                case 4: m_dir = WEST; m_col--; break;
+                default: m_dir = NORTH; break;
+            }
+        } while (!isTarget(g, m_row, m_col) && ++tries < HUNTTRIES);
+    }
+    
+      // Fire at random when not following a ship, or when following it leads nowhere
+    if (!isTarget(g, m_row, m_col)) {
+        m_findDirection = false;
+        m_setDirection = -1;
+        do {
+            m_row = random(1, MAXROWS);
+            m_col = random(1, MAXCOLS);
+        } while (!isTarget(g, m_row, m_col));
+    }
+    row = m_row;
+    col = m_col;
+}
+
+void HuntAI::observe(const Grid* g, bool sankShip) {
+    int status = g->getCellStatus(m_row, m_col);
+    
+    if (status == DAMAGED && m_findDirection) {
+        m_findDirection = false;
+        m_setDirection = m_dir;
+    }
+    else if (status == DAMAGED) {
+        m_findDirection = true;
+    }
+    else if (m_findDirection) {
+        switch (m_dir) {
+            case NORTH: m_row++; break;
+            case EAST: m_col--; break;
+            case SOUTH: m_row--; break;
+            case WEST: m_col++; break;
+            default: cout << "Issue with !'DAMAGED' and 'findDirection'" << endl; break;
+        }
+    }
+    else if (status == HIT && m_setDirection != -1) {
+        switch (m_setDirection) {
+            case NORTH: m_setDirection = SOUTH; break;
+            case EAST: m_setDirection = WEST; break;
+            case SOUTH: m_setDirection = NORTH; break;
+            case WEST: m_setDirection = EAST; break;
+            default: cout << "Issue with 'HIT' and 'setDirection'" << endl; break;
+        }
+    }
+    
+    if (sankShip) {
+        m_findDirection = false;
+        m_setDirection = -1;
+    }
+}
+
+int HuntAI::random(int lowest, int highest) {
+    uniform_int_distribution<> distro(lowest, highest);
+    return distro(m_generator);
+}
+
+bool HuntAI::isTarget(const Grid* g, int row, int col) const {
+    if (row < 1 || row > MAXROWS || col < 1 || col > MAXCOLS) {
+        return false;
+    }
+    return g->getCellStatus(row, col) != HIT && g->getCellStatus(row, col) != DAMAGED;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//  Ponderer implementation
+///////////////////////////////////////////////////////////////////////////
+
+
+Ponderer::Ponderer(Targeter* enemy, int budget) : m_cancel(false) {
+    m_enemy = enemy;
+    m_budget = budget;
+}
+
+Ponderer::~Ponderer() {
+    stop();
+}
+
+void Ponderer::start() {
+    stop();
+    m_cancel = false;
+    m_started = chrono::steady_clock::now();
+    m_thread = thread(&Ponderer::ponder, this);
+}
+
+void Ponderer::stop() {
+    m_cancel = true;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void Ponderer::finish() {
+      // The enemy's first slice is a full budget, so its move is never weaker than without pondering
+    this_thread::sleep_until(m_started + chrono::microseconds(m_budget));
+    stop();
+}
+
+void Ponderer::ponder() {
+      // One set of sampling threads for the whole window; stop() cancels them as soon as the player has moved
+    m_enemy->run(m_started + chrono::microseconds(max(PONDERLIMIT, m_budget)), &m_cancel);
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//  SparseGrid implementation
+///////////////////////////////////////////////////////////////////////////
+
+
+SparseGrid::SparseGrid(int rows, int cols, bool isOpponent) {
+    m_rows = rows;
+    m_cols = cols;
+    m_numShips = 0;
+    m_isOpponent = isOpponent;
+}
+
+SparseGrid::~SparseGrid() {
+    for (auto& entry : m_tiles) {
+        delete entry.second;
+    }
+    for (size_t i = 0; i < m_ships.size(); i++) {
+        delete m_ships[i];
+    }
+}
+
+int SparseGrid::rows() const {
+    return m_rows;
+}
+
+int SparseGrid::cols() const {
+    return m_cols;
+}
+
+int SparseGrid::numShips() const {
+    return m_numShips;
+}
+
+bool SparseGrid::isOpponent() const {
+    return m_isOpponent;
+}
+
+int SparseGrid::getCellStatus(int row, int col) const {
+    auto it = m_tiles.find(tileKey(row, col));
+    if (it == m_tiles.end()) {
+        return EMPTY;
+    }
+    return it->second->cells[(row - 1) % TILESIZE][(col - 1) % TILESIZE];
+}
+
+long SparseGrid::numTiles() const {
+    return m_tiles.size();
+}
+
+bool SparseGrid::isValidShipPos(int row, int col, int length, int orientation) const {
+    int endRow = row + (orientation == VERTICAL ? length - 1 : 0);
+    int endCol = col + (orientation == HORIZONTAL ? length - 1 : 0);
+    if (row < 1 || col < 1 || endRow > m_rows || endCol > m_cols) {
+        return false;
+    }
+    
+      // The ship and the box of cells around it, which spans at most four tiles
+    for (int i = max(row - 1, 1); i <= min(endRow + 1, m_rows); i++) {
+        for (int j = max(col - 1, 1); j <= min(endCol + 1, m_cols); j++) {
+            if (getCellStatus(i, j) != EMPTY) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void SparseGrid::addShip(string name, int row, int col, int orientation, int length) {
+    FleetShip* ship = new FleetShip;
+    ship->name = name;
+    ship->row = row;
+    ship->col = col;
+    ship->orientation = orientation;
+    ship->length = length;
+    ship->damage = 0;
+    m_ships.push_back(ship);
+    m_numShips++;
+    
+    long long lastKey = -1;
+    for (int i = 0; i < length; i++) {
+        int r = row + (orientation == VERTICAL ? i : 0);
+        int c = col + (orientation == HORIZONTAL ? i : 0);
+        setCellStatus(r, c, OCCUPIED);
+        if (tileKey(r, c) != lastKey) {
+            lastKey = tileKey(r, c);
+            m_index[lastKey].push_back(ship);
+        }
+    }
+}
+
+FleetShip* SparseGrid::hitShip(int row, int col) {
+    auto it = m_index.find(tileKey(row, col));
+    if (it == m_index.end()) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < it->second.size(); i++) {
+        FleetShip* ship = it->second[i];
+        int r = row - ship->row;
+        int c = col - ship->col;
+        if ((ship->orientation == HORIZONTAL && r == 0 && c >= 0 && c < ship->length) ||
+            (ship->orientation == VERTICAL && c == 0 && r >= 0 && r < ship->length)) {
+            ship->damage++;
+            return ship;
+        }
+    }
+    return nullptr;
+}
+
+void SparseGrid::sinkShip(FleetShip* ship) {
+      // The wreck stays in the index since its cells are still on the board
+    if (ship->damage >= ship->length) {
+        m_numShips--;
+    }
+}
+
+void SparseGrid::setCellStatus(int row, int col, int status) {
+    if (row < 1 || col < 1 || row > m_rows || col > m_cols) {
+        cout << "***** Attempted to set cell status on an invalid coordinate!" << endl;
+        return;
+    }
+    
+    Tile*& tile = m_tiles[tileKey(row, col)];
+    if (tile == nullptr) {
+        tile = new Tile;
+        for (int i = 0; i < TILESIZE; i++) {
+            for (int j = 0; j < TILESIZE; j++) {
+                tile->cells[i][j] = EMPTY;
+            }
+        }
+    }
+    tile->cells[(row - 1) % TILESIZE][(col - 1) % TILESIZE] = status;
+}
+
+long long SparseGrid::tileKey(int row, int col) const {
+    return (static_cast<long long>((row - 1) / TILESIZE) << 32) | ((col - 1) / TILESIZE);
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//  SpectatorFeed implementation
+///////////////////////////////////////////////////////////////////////////
+
+
+SpectatorFeed::SpectatorFeed(string name) {
+    m_name = feedName(name);
+    m_frame = nullptr;
+    
+      // The seqlock allows a single writer, so a name another game is still publishing under is refused
+    int fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd == -1 && errno == EEXIST) {
+        cout << "***** The spectator feed " << m_name << " is already in use by another game!" << endl;
+        return;
+    }
+    if (fd == -1 || ftruncate(fd, sizeof(FeedFrame)) == -1) {
+        cout << "***** Could not create the spectator feed " << m_name << "!" << endl;
+        if (fd != -1) {
+            close(fd);
+            shm_unlink(m_name.c_str());
+        }
+        return;
+    }
+    void* memory = mmap(nullptr, sizeof(FeedFrame), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        cout << "***** Could not map the spectator feed " << m_name << "!" << endl;
+        return;
+    }
+    m_frame = new (memory) FeedFrame();
+}
+
+SpectatorFeed::~SpectatorFeed() {
+    if (m_frame == nullptr) {
+        return;
+    }
+      // Readers that already mapped the feed keep it until they let go, they just see it closed
+    m_frame->closed.store(1, memory_order_release);
+    munmap(m_frame, sizeof(FeedFrame));
+    shm_unlink(m_name.c_str());
+}
+
+bool SpectatorFeed::isOpen() const {
+    return m_frame != nullptr;
+}
+
+void SpectatorFeed::publish(const Grid* player, const Grid* opponent, int turn) {
+    if (m_frame == nullptr) {
+        return;
+    }
+    
+    unsigned long packed[FEEDWORDS] = {};
+    for (int i = 0; i < MAXROWS; i++) {
+        for (int j = 0; j < MAXCOLS; j++) {
+            int n = i * MAXCOLS + j;
+            int m = n + MAXROWS * MAXCOLS;
+            int playerStatus = player->getCellStatus(i + 1, j + 1);
+            int opponentStatus = opponent->getCellStatus(i + 1, j + 1);
+            
+              // Fogged ships never reach shared memory, anyone who can map the feed could read them otherwise
+            if (player->isOpponent() && playerStatus == OCCUPIED) {
+                playerStatus = EMPTY;
+            }
+            if (opponent->isOpponent() && opponentStatus == OCCUPIED) {
+                opponentStatus = EMPTY;
+            }
+            packed[n / 8] |= static_cast<unsigned long>(playerStatus) << (8 * (n % 8));
+            packed[m / 8] |= static_cast<unsigned long>(opponentStatus) << (8 * (m % 8));
+        }
+    }
+    
+      // Seqlock: readers retry if the sequence was odd or moved while they copied, the writer never waits
+    unsigned long sequence = m_frame->sequence.load(memory_order_relaxed);
+    m_frame->sequence.store(sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    m_frame->turn.store(turn, memory_order_relaxed);
+    m_frame->fog.store((player->isOpponent() ? 1 : 0) | (opponent->isOpponent() ? 2 : 0), memory_order_relaxed);
+    for (int w = 0; w < FEEDWORDS; w++) {
+        m_frame->cells[w].store(packed[w], memory_order_relaxed);
+    }
+    m_frame->sequence.store(sequence + 2, memory_order_release);
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//  Auxiliary functions
+///////////////////////////////////////////////////////////////////////////
+
+
+int randInt(int lowest, int highest)
+{
+    if (highest < lowest)
+        swap(highest, lowest);
+    static random_device rd;
+    static default_random_engine generator(rd());
+    uniform_int_distribution<> distro(lowest, highest);
+    return distro(generator);
+}
+
+
+bool isValidCoord(string coord) {
+    if (coord.length() < 2 || coord.length() > 3 || !isalpha(coord.at(0)) || !isdigit(coord.at(1))) {
+        //cout << "Invalid coordinates" << endl;
+        return false;
+    }
+    if (coord.at(0) == '#') {
+        return false;
+    }
+    
+    char c = tolower(coord.at(0));
+    int num;
+    if (coord.length() == 2) {
+        num = coord.at(1) - 48;
+    }
+    else {
+        num = (coord.at(1) - 48)*10 + (coord.at(2) - 48);
+    }
+    
+    if (c > 96 + MAXROWS || num <= 0 || num > MAXCOLS) {
+        //cout << "Invalid coordinates" << endl;
+        return false;
+    }
+    
+    return true;
+}
+
+bool isValidShipPos(Grid* g, string coord, int length, int orientation) {
+    
+    if (orientation == HORIZONTAL) {
+        if (colOfCoord(coord) + length > MAXCOLS + 1) {
+            return false;
+        }
+        for (int i = 0; i < length; i++) {
+            if (g->getCellStatus(rowOfCoord(coord), colOfCoord(coord) + i) != EMPTY) {
+                return false;
+            }
+        }
+        int num = -1;
+        while (num < 2) {
+            for (int j = colOfCoord(coord) - 1; j < colOfCoord(coord) + length + 1; j++) {
+                string newCoord = getLetter(rowOfCoord(coord) + num) + to_string(j);
+                if (!isValidCoord(newCoord)) {
+                    continue;
+                }
+                if (num == 0 && j >= colOfCoord(coord) && j < colOfCoord(coord) + length) {
+                    continue;
+                }
+                if (g->getCellStatus(rowOfCoord(coord) + num, j) != EMPTY) {
+                    return false;
+                }
+            }
+            num++;
+        }
+    }
+    if (orientation == VERTICAL) {
+        if (rowOfCoord(coord) + length > MAXROWS + 1) {
+            return false;
+        }
+        for (int i = 0; i < length; i++) {
+            if (g->getCellStatus(rowOfCoord(coord) + i, colOfCoord(coord)) != EMPTY) {
+                return false;
+            }
+        }
+        int num = -1;
+        while (num < 2) {
+            for (int j = rowOfCoord(coord) - 1; j < rowOfCoord(coord) + length + 1; j++) {
+                string newCoord = getLetter(j) + to_string(colOfCoord(coord) + num);
+                if (!isValidCoord(newCoord)) {
+                    continue;
+                }
+                if (num == 0 && j >= rowOfCoord(coord) && j < rowOfCoord(coord) + length) {
+                    continue;
+                }
+                if (g->getCellStatus(j, colOfCoord(coord) + num) != EMPTY) {
+                    return false;
+                }
+            }
+            num++;
+        }
+    }
+    
+    return true;
+}
+
+int decodeOrientation(string orientation) {
+    for (int i = 0; i < orientation.length(); i++) {
+        orientation.at(i) = tolower(orientation.at(i));
+    }
+    if (orientation == "h" || orientation == "horizontal") {
+        return HORIZONTAL;
+    }
+    if (orientation == "v" || orientation == "vertical") {
+        return VERTICAL;
+    }
+    return -1;
+}
+
+int rowOfCoord(string coord) {
+    if (!isValidCoord(coord)) {
+        return -1;
+    }
+    
+    char c = tolower(coord.at(0));
+    return c - 96;
+}
+
+int colOfCoord(string coord) {
+    if (!isValidCoord(coord)) {
+        return -1;
+    }
+    
+    if (coord.length() == 2) {
+        return coord.at(1) - 48;
+    }
+    return (coord.at(1) - 48)*10 + (coord.at(2) - 48);
+}
+
+char getLetter(int n) {
     switch (n) {
         case 1: return 'A';
         case 2: return 'B';
@@ -490,82 +1406,1281 @@ char getLetter(int n) {
         case 25: return 'Y';
         case 26: return 'Z';
     }
-    return '#';
+    return '#';
+}
+
+void printNums() {
+    for (int i = 0; i < MAXCOLS; i++) {
+        if (i + 1 > 9) {
+            cout << i + 1;
+        }
+        else {
+            cout << i + 1 << " ";
+        }
+    }
+}
+
+void display(Grid* player, Grid* opponent) {
+    cout << endl << "You:";
+    for (int i = 0; i < MAXCOLS - 1; i++) {
+        cout << "  ";
+    }
+    for (int i = 0; i < SPACE; i++) {
+        cout << " ";
+    }
+    cout << "Opponent:" << endl << endl;
+    
+    cout << "  ";
+    printNums();
+    for (int i = 0; i < SPACE; i++) {
+        cout << " ";
+    }
+    cout << "  ";
+    printNums();
+    cout << endl;
+    
+    for (int i = 0; i < MAXROWS; i++) {
+        cout << getLetter(i + 1) << " ";
+        for (int j = 0; j < MAXCOLS; j++) {
+            if (player->getCellStatus(i + 1, j + 1) == EMPTY) {
+                cout << ". ";
+            }
+            else if (player->getCellStatus(i + 1, j + 1) == OCCUPIED) {
+                cout << "O ";
+            }
+            else if (player->getCellStatus(i + 1, j + 1) == HIT) {
+                cout << "  ";
+            }
+            else {
+                cout << "X ";
+            }
+        }
+        for (int k = 0; k < SPACE; k++) {
+            cout << " ";
+        }
+        cout << getLetter(i + 1) << " ";
+        for (int j = 0; j < MAXCOLS; j++) {
+            if (opponent->getCellStatus(i + 1, j + 1) == DAMAGED) {
+                cout << "X ";
+            }
+            else if (opponent->getCellStatus(i + 1, j + 1) == HIT) {
+                cout << "  ";
+            }
+            else {
+                cout << ". ";
+            }
+        }
+        cout << endl;
+    }
+}
+
+void addOppShips(Grid* g) {
+    static default_random_engine generator(random_device{}());
+    GameRecord layout;
+    
+      // randomLayout starts over when a ship has nowhere left to go instead of searching forever
+    while (!randomLayout(generator, layout)) {
+    }
+    addLayout(g, layout);
+}
+
+void addLayout(Grid* g, const GameRecord& layout) {
+    string shipName;
+    int length = 0;
+    
+    for (int i = 0; i < MAXSHIPS; i++) {
+        switch (i) {
+            case 0: shipName = "Destroyer"; length = 2; break;
+            case 1: shipName = "Submarine"; length = 3; break;
+            case 2: shipName = "Cruiser"; length = 3; break;
+            case 3: shipName = "Battleship"; length = 4; break;
+            case 4: shipName = "Carrier"; length = 5; break;
+            default: shipName = "Unnamed Ship"; length = 3; break;
+        }
+        string coord = "";
+        coord += getLetter(layout.shipRow[i]);
+        coord += to_string(layout.shipCol[i]);
+        g->addShip(shipName, coord, layout.shipOrientation[i], length);
+    }
+}
+
+int fire(Grid* g, int row, int col, string& shipName) {
+    if (g->getCellStatus(row, col) == OCCUPIED) {
+        g->setCellStatus(row, col, DAMAGED);
+        Ship* ship = g->hitShip(row, col);
+        if (ship == nullptr) {
+            cout << "Cell is labeled 'occupied' without any ship occupying it." << endl;
+            return STRUCK;
+        }
+        shipName = ship->name();
+        if (ship->hasSunk()) {
+            g->sinkShip(ship);
+            return SANK;
+        }
+        return STRUCK;
+    }
+    else if (g->getCellStatus(row, col) == EMPTY) {
+        g->setCellStatus(row, col, HIT);
+        return WATER;
+    }
+    return WASTED;
+}
+
+void attack(Grid* g, int row, int col) {
+    string shipName;
+    int result = fire(g, row, col, shipName);
+    
+    if (result == STRUCK || result == SANK) {
+        if (g->isOpponent() == false) {
+            cout << "Enemy fired at " << getLetter(row) << col << " and struck your " << shipName << "." << endl;
+            if (result == SANK) {
+                cout << "The enemy sank your " << shipName << "." << endl;
+            }
+        }
+        else {
+            cout << "You fired at " << getLetter(row) << col << " and struck an enemy ship." << endl;
+            if (result == SANK) {
+                cout << "You sank the enemy's " << shipName << "." << endl;
+            }
+        }
+    }
+    else if (result == WATER) {
+        if (g->isOpponent() == true) {
+            cout << "You fired at " << getLetter(row) << col << " and struck water." << endl;
+        }
+        else {
+            cout << "Enemy fired at " << getLetter(row) << col << " and struck water." << endl;
+        }
+    }
+    else {
+        cout << "You fired at a location that has been previously targeted. Such a waste of ammunition..." << endl;
+    }
+}
+
+int shipType(string name) {
+    if (name == "Destroyer") {
+        return DESTROYER;
+    }
+    if (name == "Submarine") {
+        return SUBMARINE;
+    }
+    if (name == "Cruiser") {
+        return CRUISER;
+    }
+    if (name == "Battleship") {
+        return BATTLESHIP;
+    }
+    if (name == "Carrier") {
+        return CARRIER;
+    }
+    return -1;
+}
+
+void recordLayout(Grid* g, GameRecord& record) {
+    for (int i = 0; i < MAXSHIPS; i++) {
+        Ship* ship = g->getShip(i);
+        record.shipRow[i] = rowOfCoord(ship->coordinate());
+        record.shipCol[i] = colOfCoord(ship->coordinate());
+        record.shipOrientation[i] = ship->orientation();
+    }
+    record.numShots = 0;
+}
+
+bool randomLayout(default_random_engine& generator, GameRecord& record) {
+    bool layout[MAXROWS + 2][MAXCOLS + 2] = {};
+    int lengths[MAXSHIPS] = { 2, 3, 3, 4, 5 };
+    
+      // Destroyer through Carrier, each clear of every other ship, diagonals included; the array has a border so the neighbour check needs no bounds tests
+    for (int s = 0; s < MAXSHIPS; s++) {
+        int row = 0;
+        int col = 0;
+        int orientation = 0;
+        bool placed = false;
+        for (int tries = 0; !placed && tries < PLACEMENTTRIES; tries++) {
+            row = generator() % MAXROWS + 1;
+            col = generator() % MAXCOLS + 1;
+            orientation = generator() % 2;
+            int endRow = row + (orientation == VERTICAL ? lengths[s] - 1 : 0);
+            int endCol = col + (orientation == HORIZONTAL ? lengths[s] - 1 : 0);
+            placed = endRow <= MAXROWS && endCol <= MAXCOLS;
+            for (int i = row - 1; placed && i <= endRow + 1; i++) {
+                for (int j = col - 1; j <= endCol + 1; j++) {
+                    if (layout[i][j]) {
+                        placed = false;
+                    }
+                }
+            }
+        }
+        if (!placed) {
+            return false;
+        }
+        for (int i = 0; i < lengths[s]; i++) {
+            layout[row + (orientation == VERTICAL ? i : 0)][col + (orientation == HORIZONTAL ? i : 0)] = true;
+        }
+        record.shipRow[s] = row;
+        record.shipCol[s] = col;
+        record.shipOrientation[s] = orientation;
+    }
+    record.numShots = 0;
+    return true;
+}
+
+void randomBaseline(GameStats& stats, long games) {
+    default_random_engine generator(random_device{}());
+    GameRecord record;
+    while (stats.games < games) {
+        if (randomLayout(generator, record)) {
+            addGame(stats, record);
+        }
+    }
+}
+
+bool appendRecord(string file, const GameRecord& record) {
+    ofstream out(file, ios::binary | ios::app);
+    if (!out) {
+        cout << "***** Could not open " << file << " to record the game!" << endl;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&record), sizeof(GameRecord));
+    return bool(out);
+}
+
+void addGame(GameStats& stats, const GameRecord& record) {
+    signed char owner[MAXROWS * MAXCOLS];
+    int damage[MAXSHIPS];
+    for (int i = 0; i < MAXROWS * MAXCOLS; i++) {
+        owner[i] = -1;
+    }
+    
+    int lengths[MAXSHIPS] = { 2, 3, 3, 4, 5 };
+    for (int s = 0; s < MAXSHIPS; s++) {
+        damage[s] = 0;
+        if (record.shipRow[s] >= 1 && record.shipCol[s] >= 1 && record.shipRow[s] <= MAXROWS && record.shipCol[s] <= MAXCOLS && record.shipOrientation[s] < 2) {
+            stats.placements[s][record.shipOrientation[s]][record.shipRow[s] - 1][record.shipCol[s] - 1]++;
+        }
+        for (int i = 0; i < lengths[s]; i++) {
+            int row = record.shipRow[s] - 1 + (record.shipOrientation[s] == VERTICAL ? i : 0);
+            int col = record.shipCol[s] - 1 + (record.shipOrientation[s] == HORIZONTAL ? i : 0);
+            if (row >= 0 && col >= 0 && row < MAXROWS && col < MAXCOLS) {
+                owner[row * MAXCOLS + col] = s;
+                stats.occupancy[row][col]++;
+            }
+        }
+    }
+    
+    bool hit = false;
+    for (int n = 0; n < record.numShots && n < MAXROWS * MAXCOLS; n++) {
+        int cell = record.shots[n];
+        if (cell >= MAXROWS * MAXCOLS || owner[cell] == -1) {
+            continue;
+        }
+        if (!hit) {
+            stats.firstHit[cell / MAXCOLS][cell % MAXCOLS]++;
+            hit = true;
+        }
+        int s = owner[cell];
+        owner[cell] = -1;
+        if (++damage[s] == lengths[s]) {
+            stats.sinkShots[s][n + 1]++;
+        }
+    }
+    stats.games++;
+}
+
+void mergeStats(GameStats& total, const GameStats& part) {
+    total.games += part.games;
+    for (int i = 0; i < MAXROWS; i++) {
+        for (int j = 0; j < MAXCOLS; j++) {
+            total.firstHit[i][j] += part.firstHit[i][j];
+            total.occupancy[i][j] += part.occupancy[i][j];
+            for (int s = 0; s < MAXSHIPS; s++) {
+                total.placements[s][HORIZONTAL][i][j] += part.placements[s][HORIZONTAL][i][j];
+                total.placements[s][VERTICAL][i][j] += part.placements[s][VERTICAL][i][j];
+            }
+        }
+    }
+    for (int s = 0; s < MAXSHIPS; s++) {
+        for (int n = 0; n <= MAXROWS * MAXCOLS; n++) {
+            total.sinkShots[s][n] += part.sinkShots[s][n];
+        }
+    }
+}
+
+void scanRange(string file, long first, long last, GameStats* stats) {
+    ifstream in(file, ios::binary);
+    in.seekg(first * sizeof(GameRecord));
+    vector<GameRecord> chunk(RECORDCHUNK);
+    
+    for (long n = first; n < last && in; n += RECORDCHUNK) {
+        long count = min(static_cast<long>(RECORDCHUNK), last - n);
+        in.read(reinterpret_cast<char*>(chunk.data()), count * sizeof(GameRecord));
+        count = in.gcount() / sizeof(GameRecord);
+        for (long i = 0; i < count; i++) {
+            addGame(*stats, chunk[i]);
+        }
+    }
+}
+
+bool scanRecords(const vector<string>& files, GameStats& stats) {
+    int numThreads = thread::hardware_concurrency();
+    if (numThreads < 1) {
+        numThreads = 1;
+    }
+    
+      // Every thread reduces into its own histograms, which are only merged at the end
+    vector<GameStats> parts;
+    vector<thread> threads;
+    vector<string> names;
+    vector<long> firsts;
+    vector<long> lasts;
+    for (size_t f = 0; f < files.size(); f++) {
+        ifstream in(files[f], ios::binary | ios::ate);
+        if (!in) {
+            cout << "***** Could not open " << files[f] << "!" << endl;
+            return false;
+        }
+        long records = in.tellg() / static_cast<long>(sizeof(GameRecord));
+        for (int t = 0; t < numThreads; t++) {
+            names.push_back(files[f]);
+            firsts.push_back(records * t / numThreads);
+            lasts.push_back(records * (t + 1) / numThreads);
+        }
+    }
+    
+    parts.assign(names.size(), GameStats());
+    for (size_t i = 0; i < names.size(); i++) {
+        threads.push_back(thread(scanRange, names[i], firsts[i], lasts[i], &parts[i]));
+        if (threads.size() == static_cast<size_t>(numThreads) || i == names.size() - 1) {
+            for (size_t t = 0; t < threads.size(); t++) {
+                threads[t].join();
+            }
+            threads.clear();
+        }
+    }
+    for (size_t i = 0; i < parts.size(); i++) {
+        mergeStats(stats, parts[i]);
+    }
+    return true;
+}
+
+void printCellTable(double table[MAXROWS][MAXCOLS], int precision) {
+    cout << "  ";
+    for (int j = 0; j < MAXCOLS; j++) {
+        cout << setw(precision + 4) << j + 1;
+    }
+    cout << endl;
+    for (int i = 0; i < MAXROWS; i++) {
+        cout << getLetter(i + 1) << " ";
+        for (int j = 0; j < MAXCOLS; j++) {
+            cout << setw(precision + 4) << fixed << setprecision(precision) << table[i][j];
+        }
+        cout << endl;
+    }
+}
+
+void analyzeRecords(const vector<string>& files) {
+    GameStats stats = GameStats();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (!scanRecords(files, stats)) {
+        exit(1);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    
+    cout << "Games: " << stats.games << " (" << fixed << setprecision(0) << stats.games / max(seconds, 1e-9) << " games per second)" << endl;
+    if (stats.games == 0) {
+        return;
+    }
+    
+    double table[MAXROWS][MAXCOLS];
+    for (int i = 0; i < MAXROWS; i++) {
+        for (int j = 0; j < MAXCOLS; j++) {
+            table[i][j] = 100.0 * stats.firstHit[i][j] / stats.games;
+        }
+    }
+    cout << endl << "First hit (% of games):" << endl;
+    printCellTable(table, 1);
+    
+    cout << endl << "Shots to sink:        mean  median     p90" << endl;
+    string names[MAXSHIPS] = { "Destroyer", "Submarine", "Cruiser", "Battleship", "Carrier" };
+    for (int s = 0; s < MAXSHIPS; s++) {
+        long sunk = 0;
+        double total = 0;
+        for (int n = 0; n <= MAXROWS * MAXCOLS; n++) {
+            sunk += stats.sinkShots[s][n];
+            total += static_cast<double>(n) * stats.sinkShots[s][n];
+        }
+        int median = 0;
+        int p90 = 0;
+        long seen = 0;
+        for (int n = 0; n <= MAXROWS * MAXCOLS; n++) {
+            seen += stats.sinkShots[s][n];
+            if (median == 0 && seen * 2 >= sunk && sunk > 0) {
+                median = n;
+            }
+            if (p90 == 0 && seen * 10 >= sunk * 9 && sunk > 0) {
+                p90 = n;
+            }
+        }
+        cout << setw(12) << left << names[s] << right << setw(14) << setprecision(1) << (sunk > 0 ? total / sunk : 0) << setw(8) << median << setw(8) << p90 << endl;
+    }
+    
+      // Random layouts are what the enemy assumes, so that is the baseline human placements are compared to
+    GameStats* baseline = new GameStats();
+    randomBaseline(*baseline, BASELINEGAMES);
+    
+    long humanTotal = 0;
+    long baselineTotal = 0;
+    for (int i = 0; i < MAXROWS; i++) {
+        for (int j = 0; j < MAXCOLS; j++) {
+            humanTotal += stats.occupancy[i][j];
+            baselineTotal += baseline->occupancy[i][j];
+        }
+    }
+    double distance = 0;
+    for (int i = 0; i < MAXROWS; i++) {
+        for (int j = 0; j < MAXCOLS; j++) {
+            double human = static_cast<double>(stats.occupancy[i][j]) / max(humanTotal, 1L);
+            double random = static_cast<double>(baseline->occupancy[i][j]) / max(baselineTotal, 1L);
+            distance += fabs(human - random) / 2;
+            table[i][j] = random > 0 ? human / random : 0;
+        }
+    }
+    delete baseline;
+    cout << endl << "Player placements relative to random layouts (total variation distance " << setprecision(3) << distance << "):" << endl;
+    printCellTable(table, 2);
+}
+
+void trainPriors(string file, const vector<string>& records) {
+    GameStats* stats = new GameStats();
+    GameStats* baseline = new GameStats();
+    if (!scanRecords(records, *stats)) {
+        exit(1);
+    }
+    if (stats->games == 0) {
+        cout << "***** There are no recorded games to learn from!" << endl;
+        exit(1);
+    }
+    randomBaseline(*baseline, BASELINEGAMES);
+    
+      // Each placement's share among player layouts, pulled towards the random share when there is little data
+    PriorTable* priors = new PriorTable();
+    for (int s = 0; s < MAXSHIPS; s++) {
+        for (int o = 0; o < 2; o++) {
+            for (int i = 0; i < MAXROWS; i++) {
+                for (int j = 0; j < MAXCOLS; j++) {
+                    double random = static_cast<double>(baseline->placements[s][o][i][j]) / baseline->games;
+                    double learned = (stats->placements[s][o][i][j] + PRIORSTRENGTH * random) / (stats->games + PRIORSTRENGTH);
+                    double weight = random > 0 ? learned / random : 1;
+                    weight = min(max(weight, 1.0 / 16), 16.0);
+                    priors->weight[s][o][i][j] = static_cast<unsigned short>(lround(weight * PRIORONE));
+                }
+            }
+        }
+    }
+    
+    ofstream out(file, ios::binary | ios::trunc);
+    out.write("BSPR", 4);
+    out.write(reinterpret_cast<const char*>(priors), sizeof(PriorTable));
+    if (!out) {
+        cout << "***** Could not write the priors to " << file << "!" << endl;
+        exit(1);
+    }
+    
+    cout << "Learned from " << stats->games << " games, wrote " << sizeof(PriorTable) << " bytes of priors to " << file << "." << endl;
+    
+    delete stats;
+    delete baseline;
+    delete priors;
+}
+
+bool loadPriors(string file, PriorTable& priors) {
+    ifstream in(file, ios::binary);
+    char magic[4];
+    in.read(magic, 4);
+    in.read(reinterpret_cast<char*>(&priors), sizeof(PriorTable));
+    if (!in || string(magic, 4) != "BSPR") {
+        cout << "***** " << file << " is not a priors file!" << endl;
+        return false;
+    }
+    return true;
+}
+
+string feedName(string name) {
+    return "/battleship-" + name;
+}
+
+const FeedFrame* openFeed(string name) {
+    int fd = shm_open(feedName(name).c_str(), O_RDONLY, 0);
+    if (fd == -1) {
+        return nullptr;
+    }
+    void* memory = mmap(nullptr, sizeof(FeedFrame), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        return nullptr;
+    }
+    return static_cast<const FeedFrame*>(memory);
+}
+
+bool readFrame(const FeedFrame* frame, FeedSnapshot& snapshot) {
+    unsigned long words[FEEDWORDS];
+    unsigned long before = 0;
+    unsigned long after = 0;
+    do {
+        before = frame->sequence.load(memory_order_acquire);
+        snapshot.turn = frame->turn.load(memory_order_relaxed);
+        snapshot.fog = frame->fog.load(memory_order_relaxed);
+        for (int w = 0; w < FEEDWORDS; w++) {
+            words[w] = frame->cells[w].load(memory_order_relaxed);
+        }
+        atomic_thread_fence(memory_order_acquire);
+        after = frame->sequence.load(memory_order_relaxed);
+    } while ((before & 1) != 0 || before != after);
+    
+    for (int n = 0; n < FEEDWORDS * 8; n++) {
+        snapshot.cells[n] = (words[n / 8] >> (8 * (n % 8))) & 0xff;
+    }
+    snapshot.closed = frame->closed.load(memory_order_acquire) != 0;
+    return before != 0;
+}
+
+void displayFrame(const FeedSnapshot& snapshot) {
+    cout << endl << "Turn " << snapshot.turn << endl << "  ";
+    printNums();
+    for (int i = 0; i < SPACE; i++) {
+        cout << " ";
+    }
+    cout << "  ";
+    printNums();
+    cout << endl;
+    
+    for (int i = 0; i < MAXROWS; i++) {
+        for (int b = 0; b < 2; b++) {
+            bool fog = (snapshot.fog >> b) & 1;
+            cout << getLetter(i + 1) << " ";
+            for (int j = 0; j < MAXCOLS; j++) {
+                int status = snapshot.cells[b * MAXROWS * MAXCOLS + i * MAXCOLS + j];
+                if (status == EMPTY || (fog && status == OCCUPIED)) {
+                    cout << ". ";
+                }
+                else if (status == OCCUPIED) {
+                    cout << "O ";
+                }
+                else if (status == HIT) {
+                    cout << "  ";
+                }
+                else {
+                    cout << "X ";
+                }
+            }
+            for (int k = 0; b == 0 && k < SPACE; k++) {
+                cout << " ";
+            }
+        }
+        cout << endl;
+    }
+}
+
+void spectate(string name) {
+    const FeedFrame* frame = openFeed(name);
+    if (frame == nullptr) {
+        cout << "***** There is no game called " << name << " to watch!" << endl;
+        exit(1);
+    }
+    
+    FeedSnapshot snapshot;
+    unsigned long shown = 0;
+    do {
+        if (readFrame(frame, snapshot) && snapshot.turn != shown) {
+            displayFrame(snapshot);
+            shown = snapshot.turn;
+        }
+        this_thread::sleep_for(chrono::milliseconds(50));
+    } while (!snapshot.closed);
+    cout << endl << "The game is over." << endl;
+    munmap(const_cast<FeedFrame*>(frame), sizeof(FeedFrame));
+}
+
+void benchFeed(int numReaders) {
+    string name = "bench-" + to_string(getpid());
+      // Neither board is fogged, so every status a frame is filled with reaches the readers unchanged
+    Grid* player = new Grid(false);
+    Grid* opponent = new Grid(false);
+    
+      // Shared counters the reader processes add their totals to
+    void* memory = mmap(nullptr, 2 * sizeof(atomic<long>), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        cout << "***** Could not map the benchmark counters!" << endl;
+        exit(1);
+    }
+    atomic<long>* totals = new (memory) atomic<long>[2]();
+    
+    for (int round = 0; round < 2; round++) {
+        int readers = round == 0 ? 0 : numReaders;
+        SpectatorFeed* feed = new SpectatorFeed(name);
+        if (!feed->isOpen()) {
+            exit(1);
+        }
+        
+        vector<pid_t> children;
+        for (int r = 0; r < readers; r++) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                  // Every frame is filled with one status derived from its turn, so a torn read shows up as a mix
+                const FeedFrame* frame = openFeed(name);
+                FeedSnapshot snapshot;
+                long frames = 0;
+                long torn = 0;
+                do {
+                    if (readFrame(frame, snapshot)) {
+                        frames++;
+                        for (int n = 0; n < 2 * MAXROWS * MAXCOLS; n++) {
+                            if (snapshot.cells[n] != snapshot.turn % 4) {
+                                torn++;
+                                break;
+                            }
+                        }
+                    }
+                    this_thread::yield();
+                } while (!snapshot.closed);
+                totals[0] += frames;
+                totals[1] += torn;
+                _exit(0);
+            }
+            children.push_back(pid);
+        }
+        
+        vector<double> latencies;
+        for (int turn = 1; turn <= FEEDFRAMES; turn++) {
+            for (int i = 1; i <= MAXROWS; i++) {
+                for (int j = 1; j <= MAXCOLS; j++) {
+                    player->setCellStatus(i, j, turn % 4);
+                    opponent->setCellStatus(i, j, turn % 4);
+                }
+            }
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            feed->publish(player, opponent, turn);
+            latencies.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+            this_thread::sleep_for(chrono::microseconds(FEEDINTERVAL));
+        }
+        delete feed;
+        for (size_t r = 0; r < children.size(); r++) {
+            waitpid(children[r], nullptr, 0);
+        }
+        
+        sort(latencies.begin(), latencies.end());
+        cout << setw(6) << readers << " readers: publish median " << fixed << setprecision(3) << latencies[latencies.size() / 2]
+             << " us, p99 " << latencies[latencies.size() * 99 / 100] << " us, max " << latencies.back() << " us" << endl;
+    }
+    cout << "Readers saw " << totals[0] << " frames, " << totals[1] << " of them torn." << endl;
+    
+    munmap(memory, 2 * sizeof(atomic<long>));
+    delete player;
+    delete opponent;
+}
+
+void chooseFfaShot(vector<FfaPlayer>& players, const vector<int>& alive, int shooter, default_random_engine& generator, FfaShot& shot) {
+    int target = shooter;
+    while (target == shooter) {
+        target = alive[generator() % alive.size()];
+    }
+    FfaPlayer& p = players[target];
+    shot.shooter = shooter;
+    shot.target = target;
+    
+      // Follow up on hits first, then work through the shuffled cells; both skip what has been shot already
+    int cell = -1;
+    while (cell == -1 && !p.leads.empty()) {
+        int lead = p.leads.back();
+        p.leads.pop_back();
+        int status = p.grid->getCellStatus(lead / MAXCOLS + 1, lead % MAXCOLS + 1);
+        if (status == EMPTY || status == OCCUPIED) {
+            cell = lead;
+        }
+    }
+    while (cell == -1 && p.nextCell < MAXROWS * MAXCOLS) {
+        int next = p.cells[p.nextCell++];
+        int status = p.grid->getCellStatus(next / MAXCOLS + 1, next % MAXCOLS + 1);
+        if (status == EMPTY || status == OCCUPIED) {
+            cell = next;
+        }
+    }
+    if (cell == -1) {
+        cell = 0;
+    }
+    shot.row = cell / MAXCOLS + 1;
+    shot.col = cell % MAXCOLS + 1;
+}
+
+int resolveFfaRound(vector<FfaPlayer>& players, const vector<FfaShot>& shots, int round, bool verbose) {
+    int eliminated = 0;
+    string shipName;
+    
+    for (size_t i = 0; i < shots.size(); i++) {
+        const FfaShot& shot = shots[i];
+        FfaPlayer& target = players[shot.target];
+        int result = fire(target.grid, shot.row, shot.col, shipName);
+        
+        if (result == STRUCK) {
+            int row = shot.row - 1;
+            int col = shot.col - 1;
+            if (row > 0) {
+                target.leads.push_back((row - 1) * MAXCOLS + col);
+            }
+            if (row < MAXROWS - 1) {
+                target.leads.push_back((row + 1) * MAXCOLS + col);
+            }
+            if (col > 0) {
+                target.leads.push_back(row * MAXCOLS + col - 1);
+            }
+            if (col < MAXCOLS - 1) {
+                target.leads.push_back(row * MAXCOLS + col + 1);
+            }
+        }
+        else if (result == SANK) {
+            target.leads.clear();
+        }
+        
+        if (verbose && (players[shot.shooter].human || target.human)) {
+            cout << (players[shot.shooter].human ? "You" : "Player " + to_string(shot.shooter + 1)) << " fired at "
+                 << (target.human ? "your" : "player " + to_string(shot.target + 1) + "'s") << " " << getLetter(shot.row) << shot.col;
+            switch (result) {
+                case WATER: cout << " and struck water." << endl; break;
+                case STRUCK: cout << " and struck a " << shipName << "." << endl; break;
+                case SANK: cout << " and sank a " << shipName << "." << endl; break;
+                default: cout << ", a location that has been previously targeted." << endl; break;
+            }
+        }
+    }
+    
+      // Shots in a round all land before anyone is taken out, so a fleet that was sunk still got its last shot in
+    for (size_t i = 0; i < shots.size(); i++) {
+        FfaPlayer& target = players[shots[i].target];
+        if (target.eliminated == 0 && target.grid->numShips() == 0) {
+            target.eliminated = round;
+            eliminated++;
+            if (verbose) {
+                cout << (target.human ? "Your fleet has" : "Player " + to_string(shots[i].target + 1) + "'s fleet has") << " been destroyed." << endl;
+            }
+        }
+    }
+    return eliminated;
+}
+
+void playFfa(int numPlayers, bool humanPlays, default_random_engine& generator, long& rounds, long& shotsFired, double& seconds) {
+    vector<FfaPlayer> players(numPlayers);
+    vector<int> alive;
+    vector<FfaShot> shots;
+    GameRecord layout;
+    
+    for (int i = 0; i < numPlayers; i++) {
+        players[i].human = humanPlays && i == 0;
+        players[i].grid = new Grid(!players[i].human);
+        while (!randomLayout(generator, layout)) {
+        }
+        addLayout(players[i].grid, layout);
+        for (int n = 0; n < MAXROWS * MAXCOLS; n++) {
+            players[i].cells[n] = n;
+        }
+        shuffle(players[i].cells, players[i].cells + MAXROWS * MAXCOLS, generator);
+        players[i].nextCell = 0;
+        players[i].eliminated = 0;
+        alive.push_back(i);
+    }
+    
+    string input;
+    int round = 0;
+    while (alive.size() > 1) {
+        round++;
+        bool humanAlive = humanPlays && players[0].eliminated == 0;
+        if (humanAlive) {
+            cout << endl << "Round " << round << ". Your fleet:" << endl;
+            players[0].grid->displayGrid();
+            cout << endl << "Fleets still afloat:";
+            for (size_t i = 0; i < alive.size(); i++) {
+                if (alive[i] != 0) {
+                    cout << " " << alive[i] + 1 << " (" << players[alive[i]].grid->numShips() << " ships)";
+                }
+            }
+            cout << endl;
+        }
+        
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        shots.clear();
+        for (size_t i = 0; i < alive.size(); i++) {
+            if (players[alive[i]].human) {
+                continue;
+            }
+            FfaShot shot;
+            chooseFfaShot(players, alive, alive[i], generator, shot);
+            shots.push_back(shot);
+        }
+        seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        
+        if (humanAlive) {
+            FfaShot shot;
+            shot.shooter = 0;
+            shot.target = 0;
+            while (shot.target < 1 || shot.target >= numPlayers || players[shot.target].eliminated != 0) {
+                cout << "Target player: ";
+                if (!getline(cin, input)) {
+                    return;
+                }
+                shot.target = atoi(input.c_str()) - 1;
+            }
+            players[shot.target].grid->displayGrid();
+            cout << "Coordinates: ";
+            getline(cin, input);
+            cout << endl;
+            if (isValidCoord(input)) {
+                shot.row = rowOfCoord(input);
+                shot.col = colOfCoord(input);
+                shots.push_back(shot);
+            }
+            else {
+                cout << "You fired at " << input << ", a location that is not even on the map. Such a waste of ammunition..." << endl;
+            }
+        }
+        
+        shotsFired += shots.size();
+        start = chrono::steady_clock::now();
+        if (resolveFfaRound(players, shots, round, humanPlays) > 0) {
+            vector<int> afloat;
+            for (size_t i = 0; i < alive.size(); i++) {
+                if (players[alive[i]].eliminated == 0) {
+                    afloat.push_back(alive[i]);
+                }
+            }
+            alive.swap(afloat);
+        }
+        seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+    rounds += round;
+    
+    if (humanPlays) {
+        cout << endl << "-----------------------------" << endl;
+        if (alive.size() == 1 && alive[0] == 0) {
+            cout << "      ***  VICTORY  ***     " << endl << "Yours is the last fleet afloat after " << round << " rounds." << endl;
+        }
+        else if (alive.size() == 1) {
+            cout << "Player " << alive[0] + 1 << " is the last fleet afloat after " << round << " rounds." << endl;
+        }
+        else {
+            cout << "       ***  DRAW  ***       " << endl << "The last fleets sank each other in round " << round << "." << endl;
+        }
+    }
+    for (int i = 0; i < numPlayers; i++) {
+        delete players[i].grid;
+    }
+}
+
+void benchFfa() {
+    default_random_engine generator(random_device{}());
+    
+    for (int numPlayers = 2; numPlayers <= MAXPLAYERS; numPlayers *= 2) {
+        long rounds = 0;
+        long shotsFired = 0;
+        double seconds = 0;
+        int games = max(1, FFAGAMES / numPlayers);
+        for (int g = 0; g < games; g++) {
+            playFfa(numPlayers, false, generator, rounds, shotsFired, seconds);
+        }
+        cout << setw(3) << numPlayers << " players: " << fixed << setprecision(2) << 1e6 * seconds / rounds << " us per round, "
+             << setprecision(1) << 1e9 * seconds / shotsFired << " ns per shot" << endl;
+    }
+}
+
+void playLayout(default_random_engine& generator, long samples, const PriorTable* priors, GameRecord& record) {
+    record.numShots = 0;
+    Grid* g = new Grid(false);
+    addLayout(g, record);
+    HuntAI hunter(generator());
+    
+    int row = 0;
+    int col = 0;
+    string shipName;
+    while (g->numShips() > 0 && record.numShots < MAXROWS * MAXCOLS) {
+        if (samples > 0) {
+            Targeter targeter(g, priors);
+            targeter.runSamples(samples, generator);
+            targeter.bestTarget(row, col, &generator);
+        }
+        else {
+            hunter.nextShot(g, row, col);
+        }
+        record.shots[record.numShots++] = (row - 1) * MAXCOLS + col - 1;
+        int result = fire(g, row, col, shipName);
+        if (samples == 0) {
+            hunter.observe(g, result == SANK);
+        }
+    }
+    delete g;
+}
+
+void simulateGame(long seed, long samples, const PriorTable* priors, GameRecord& record) {
+    default_random_engine generator(seed);
+    while (!randomLayout(generator, record)) {
+    }
+    playLayout(generator, samples, priors, record);
+}
+
+string shardFile(string dir, int shard, string extension) {
+    return dir + "/shard-" + to_string(shard) + extension;
+}
+
+bool readCheckpoint(string file, long& next, long& bytes) {
+    ifstream in(file);
+    return bool(in >> next >> bytes);
+}
+
+bool writeCheckpoint(string file, long next, long bytes) {
+      // Written beside the old one and renamed over it, so a crash leaves one or the other intact
+    string temp = file + ".tmp";
+    string text = to_string(next) + " " + to_string(bytes) + "\n";
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        return false;
+    }
+    bool ok = writeAll(fd, text.c_str(), text.length()) && fsync(fd) == 0;
+    close(fd);
+    return ok && rename(temp.c_str(), file.c_str()) == 0;
 }
 
-void printNums() {
-    for (int i = 0; i < MAXCOLS; i++) {
-        if (i + 1 > 9) {
-            cout << i + 1;
+bool writeAll(int fd, const char* data, long length) {
+    while (length > 0) {
+        long written = write(fd, data, length);
+        if (written <= 0) {
+            return false;
         }
-        else {
-            cout << i + 1 << " ";
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+void runShard(string dir, int shard, long first, long last, long samples, const PriorTable* priors) {
+    int fd = open(shardFile(dir, shard, ".bin").c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd == -1) {
+        cout << "***** Could not open " << shardFile(dir, shard, ".bin") << "!" << endl;
+        _exit(1);
+    }
+    
+      // A worker left over from a killed driver may still be writing this shard, and two writers would interleave
+    if (flock(fd, LOCK_EX | LOCK_NB) == -1) {
+        cout << "***** " << shardFile(dir, shard, ".bin") << " is still being written by another process!" << endl;
+        _exit(SHARDLOCKED);
+    }
+    
+    long next = first;
+    long bytes = 0;
+    readCheckpoint(shardFile(dir, shard, ".ckpt"), next, bytes);
+    
+      // Anything past the checkpoint may be half written, and its seeds will be played again anyway
+    if (ftruncate(fd, bytes) == -1 || lseek(fd, bytes, SEEK_SET) == -1) {
+        cout << "***** Could not open " << shardFile(dir, shard, ".bin") << "!" << endl;
+        _exit(1);
+    }
+    
+    vector<GameRecord> chunk;
+    while (next < last) {
+        chunk.clear();
+        for (long n = next; n < last && n < next + CHECKPOINTGAMES; n++) {
+            chunk.push_back(GameRecord());
+            simulateGame(n, samples, priors, chunk.back());
+        }
+        long length = chunk.size() * sizeof(GameRecord);
+        if (!writeAll(fd, reinterpret_cast<const char*>(chunk.data()), length) || fsync(fd) != 0) {
+            cout << "***** Could not write " << shardFile(dir, shard, ".bin") << "!" << endl;
+            _exit(1);
+        }
+        next += chunk.size();
+        bytes += length;
+        if (!writeCheckpoint(shardFile(dir, shard, ".ckpt"), next, bytes)) {
+            cout << "***** Could not checkpoint " << shardFile(dir, shard, ".bin") << "!" << endl;
+            _exit(1);
         }
     }
+    close(fd);
+    _exit(0);
 }
 
-void display(Grid* player, Grid* opponent) {
-    cout << endl << "You:";
-    for (int i = 0; i < MAXCOLS - 1; i++) {
-        cout << "  ";
+bool readRun(string dir, long& games, int& workers, long& samples, int& usesPriors) {
+    ifstream in(dir + "/run.txt");
+    return bool(in >> games >> workers >> samples >> usesPriors);
+}
+
+long shardProgress(string dir, int shard, long games, int workers) {
+    long next = games * shard / workers;
+    long bytes = 0;
+    readCheckpoint(shardFile(dir, shard, ".ckpt"), next, bytes);
+    return next - games * shard / workers;
+}
+
+void simulate(string dir, long games, int workers, long samples, const PriorTable* priors) {
+    long runGames = 0;
+    int runWorkers = 0;
+    long runSamples = 0;
+    int runPriors = 0;
+    int usesPriors = priors != nullptr && samples > 0 ? 1 : 0;
+    mkdir(dir.c_str(), 0755);
+    if (readRun(dir, runGames, runWorkers, runSamples, runPriors)) {
+        if (runGames != games || runWorkers != workers || runSamples != samples || runPriors != usesPriors) {
+            cout << "***** " << dir << " holds a run of " << runGames << " games on " << runWorkers << " workers with " << runSamples << " samples per shot"
+                 << (runPriors ? " and priors" : "") << ", resume it with the same settings!" << endl;
+            exit(1);
+        }
+        cout << "Resuming the run in " << dir << " from its checkpoints." << endl;
     }
-    for (int i = 0; i < SPACE; i++) {
-        cout << " ";
+    else if (ifstream(dir + "/run.txt")) {
+        cout << "***** " << dir << "/run.txt is unreadable, refusing to start over on top of it!" << endl;
+        exit(1);
+    }
+    else {
+        ofstream out(dir + "/run.txt");
+        out << games << " " << workers << " " << samples << " " << usesPriors << endl;
+        if (!out) {
+            cout << "***** Could not start a run in " << dir << "!" << endl;
+            exit(1);
+        }
     }
-    cout << "Opponent:" << endl << endl;
     
-    cout << "  ";
-    printNums();
-    for (int i = 0; i < SPACE; i++) {
-        cout << " ";
+    long done = 0;
+    for (int k = 0; k < workers; k++) {
+        done += shardProgress(dir, k, games, workers);
     }
-    cout << "  ";
-    printNums();
-    cout << endl;
     
-    for (int i = 0; i < MAXROWS; i++) {
-        cout << getLetter(i + 1) << " ";
-        for (int j = 0; j < MAXCOLS; j++) {
-            if (player->getCellStatus(i + 1, j + 1) == EMPTY) {
-                cout << ". ";
-            }
-            else if (player->getCellStatus(i + 1, j + 1) == OCCUPIED) {
-                cout << "O ";
-            }
-            else if (player->getCellStatus(i + 1, j + 1) == HIT) {
-                cout << "  ";
-            }
-            else {
-                cout << "X ";
+      // Each worker owns the seeds of one contiguous range and only ever touches its own shard files
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<pid_t> pids(workers, 0);
+    vector<int> restarts(workers, 0);
+    int running = 0;
+    cout.flush();
+    for (int k = 0; k < workers; k++) {
+        pids[k] = fork();
+        if (pids[k] == 0) {
+            runShard(dir, k, games * k / workers, games * (k + 1) / workers, samples, priors);
+        }
+        running++;
+    }
+    
+    vector<bool> finished(workers, false);
+    while (running > 0) {
+        int status = 0;
+        pid_t pid = wait(&status);
+        if (pid == -1) {
+            if (errno == EINTR) {
+                continue;
             }
+            break;
         }
-        for (int k = 0; k < SPACE; k++) {
-            cout << " ";
+        int k = find(pids.begin(), pids.end(), pid) - pids.begin();
+        if (k == workers) {
+            continue;
         }
-        cout << getLetter(i + 1) << " ";
-        for (int j = 0; j < MAXCOLS; j++) {
-            if (opponent->getCellStatus(i + 1, j + 1) == DAMAGED) {
-                cout << "X ";
-            }
-            else if (opponent->getCellStatus(i + 1, j + 1) == HIT) {
-                cout << "  ";
+        running--;
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            finished[k] = true;
+        }
+        else if (WIFEXITED(status) && WEXITSTATUS(status) == SHARDLOCKED) {
+            cout << "***** Worker " << k << " found its shard in use, stop the old run before resuming." << endl;
+        }
+        else if (restarts[k] < MAXRESTARTS) {
+            restarts[k]++;
+            cout << "***** Worker " << k << " stopped, restarting it from its last checkpoint." << endl;
+            cout.flush();
+            pids[k] = fork();
+            if (pids[k] == 0) {
+                runShard(dir, k, games * k / workers, games * (k + 1) / workers, samples, priors);
             }
-            else {
-                cout << ". ";
+            running++;
+        }
+        else {
+            cout << "***** Worker " << k << " keeps stopping, run the same command again to resume." << endl;
+        }
+    }
+    
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    long total = 0;
+    for (int k = 0; k < workers; k++) {
+        total += shardProgress(dir, k, games, workers);
+    }
+    cout << "Simulated " << total - done << " games on " << workers << " workers in " << fixed << setprecision(2) << seconds << " s ("
+         << setprecision(0) << (total - done) / max(seconds, 1e-9) << " games per second)." << endl;
+    if (find(finished.begin(), finished.end(), false) == finished.end()) {
+        mergeShards(dir);
+    }
+}
+
+void mergeShards(string dir) {
+    long games = 0;
+    int workers = 0;
+    long samples = 0;
+    int usesPriors = 0;
+    if (!readRun(dir, games, workers, samples, usesPriors)) {
+        cout << "***** " << dir << " does not hold a simulation run!" << endl;
+        exit(1);
+    }
+    
+    string merged = dir + "/games.bin";
+    string temp = merged + ".tmp";
+    ofstream out(temp, ios::binary | ios::trunc);
+    long histogram[MAXROWS * MAXCOLS + 1] = {};
+    long total = 0;
+    vector<GameRecord> chunk(RECORDCHUNK);
+    
+      // Only what each checkpoint vouches for is merged, a shard may have more on disk from a crashed worker
+    for (int k = 0; k < workers; k++) {
+        long next = 0;
+        long bytes = 0;
+        if (!readCheckpoint(shardFile(dir, k, ".ckpt"), next, bytes)) {
+            continue;
+        }
+        ifstream in(shardFile(dir, k, ".bin"), ios::binary);
+        long records = bytes / sizeof(GameRecord);
+        for (long n = 0; n < records && in; n += RECORDCHUNK) {
+            long count = min(static_cast<long>(RECORDCHUNK), records - n);
+            in.read(reinterpret_cast<char*>(chunk.data()), count * sizeof(GameRecord));
+            count = in.gcount() / sizeof(GameRecord);
+            out.write(reinterpret_cast<const char*>(chunk.data()), count * sizeof(GameRecord));
+            for (long i = 0; i < count; i++) {
+                histogram[chunk[i].numShots]++;
             }
+            total += count;
         }
-        cout << endl;
+    }
+    out.close();
+    if (!out || rename(temp.c_str(), merged.c_str()) != 0) {
+        cout << "***** Could not write " << merged << "!" << endl;
+        exit(1);
+    }
+    
+    double sum = 0;
+    int median = 0;
+    int p90 = 0;
+    long seen = 0;
+    for (int n = 0; n <= MAXROWS * MAXCOLS; n++) {
+        sum += static_cast<double>(n) * histogram[n];
+        seen += histogram[n];
+        if (median == 0 && seen * 2 >= total && total > 0) {
+            median = n;
+        }
+        if (p90 == 0 && seen * 10 >= total * 9 && total > 0) {
+            p90 = n;
+        }
+    }
+    cout << "Merged " << total << " of " << games << " games into " << merged << "." << endl;
+    if (total > 0) {
+        cout << "Shots to win: mean " << fixed << setprecision(2) << sum / total << ", median " << median << ", p90 " << p90 << endl;
     }
 }
 
-void addOppShips(Grid* g) {
+void evaluateRange(const vector<GameRecord>* layouts, long first, long last, long samples, const PriorTable* priors, EvalStats* stats) {
+    for (long n = first; n < last; n++) {
+        long shots[2];
+        for (int withPriors = 0; withPriors < 2; withPriors++) {
+              // Both games of a layout start from the same seed, so only the priors differ between them
+            GameRecord game = (*layouts)[n];
+            default_random_engine generator(n);
+            playLayout(generator, samples, withPriors ? priors : nullptr, game);
+            shots[withPriors] = game.numShots;
+            stats->shots[withPriors] += game.numShots;
+        }
+        stats->squares += (shots[1] - shots[0]) * (shots[1] - shots[0]);
+        stats->games++;
+    }
+}
+
+void evaluatePriors(string file, const vector<string>& records, long samples) {
+    PriorTable* priors = new PriorTable();
+    if (!loadPriors(file, *priors)) {
+        exit(1);
+    }
+    vector<GameRecord> layouts;
+    for (size_t f = 0; f < records.size(); f++) {
+        ifstream in(records[f], ios::binary);
+        if (!in) {
+            cout << "***** Could not open " << records[f] << "!" << endl;
+            exit(1);
+        }
+        GameRecord record;
+        while (in.read(reinterpret_cast<char*>(&record), sizeof(GameRecord))) {
+            layouts.push_back(record);
+        }
+    }
+    if (layouts.empty()) {
+        cout << "***** There are no recorded games to evaluate on!" << endl;
+        exit(1);
+    }
+    
+    int numThreads = thread::hardware_concurrency();
+    if (numThreads < 1) {
+        numThreads = 1;
+    }
+    long games = layouts.size();
+    vector<EvalStats> parts(numThreads, EvalStats());
+    vector<thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.push_back(thread(evaluateRange, &layouts, games * t / numThreads, games * (t + 1) / numThreads, samples, priors, &parts[t]));
+    }
+    EvalStats total = EvalStats();
+    for (int t = 0; t < numThreads; t++) {
+        threads[t].join();
+        total.games += parts[t].games;
+        total.shots[0] += parts[t].shots[0];
+        total.shots[1] += parts[t].shots[1];
+        total.squares += parts[t].squares;
+    }
+    delete priors;
+    
+    double without = static_cast<double>(total.shots[0]) / total.games;
+    double with = static_cast<double>(total.shots[1]) / total.games;
+    double difference = with - without;
+    double variance = max(static_cast<double>(total.squares) / total.games - difference * difference, 0.0);
+    cout << "Played " << total.games << " recorded layouts with " << samples << " samples per shot." << endl;
+    cout << "Shots to win: mean " << fixed << setprecision(2) << without << " without priors, " << with << " with priors" << endl;
+    cout << "Difference: " << showpos << difference << noshowpos << " shots per game (standard error " << sqrt(variance / total.games) << ")" << endl;
+}
+
+string rowLabel(int n) {
+    string label;
+    while (n > 0) {
+        n--;
+        label.insert(label.begin(), getLetter(n % 26 + 1));
+        n /= 26;
+    }
+    return label;
+}
+
+bool parseLargeCoord(string coord, int rows, int cols, int& row, int& col) {
+    size_t i = 0;
+    row = 0;
+    col = 0;
+    while (i < coord.length() && isalpha(coord.at(i))) {
+        row = row * 26 + (tolower(coord.at(i)) - 96);
+        if (row > rows) {
+            return false;
+        }
+        i++;
+    }
+    if (i == 0 || i == coord.length()) {
+        return false;
+    }
+    while (i < coord.length() && isdigit(coord.at(i))) {
+        col = col * 10 + (coord.at(i) - 48);
+        if (col > cols) {
+            return false;
+        }
+        i++;
+    }
+    return i == coord.length() && row >= 1 && col >= 1;
+}
+
+void addRandomFleet(SparseGrid* g, int numShips) {
     string shipName;
     int length = 0;
-    string coord;
-    int orientation = 0;
     
-    for (int i = 0; i < MAXSHIPS; i++) {
-        switch (g->numShips()) {
+    for (int i = 0; i < numShips; i++) {
+        switch (i % MAXSHIPS) {
             case 0: shipName = "Destroyer"; length = 2; break;
             case 1: shipName = "Submarine"; length = 3; break;
             case 2: shipName = "Cruiser"; length = 3; break;
@@ -573,62 +2688,275 @@ void addOppShips(Grid* g) {
             case 4: shipName = "Carrier"; length = 5; break;
             default: shipName = "Unnamed Ship"; length = 3; break;
         }
+        int row = 0;
+        int col = 0;
+        int orientation = 0;
+        int tries = 0;
         do {
-            int row = randInt(0, MAXROWS - 1);
-            int col = randInt(0, MAXCOLS - 1);
+            if (tries++ > 1000) {
+                cout << "***** The board is too small to fit " << numShips << " ships!" << endl;
+                exit(1);
+            }
+            row = randInt(1, g->rows());
+            col = randInt(1, g->cols());
             orientation = randInt(0, 1);
-            coord = "";
-            coord += getLetter(row + 1);
-            coord += to_string(col + 1);
-            //cout << "coord: " << coord << " " << orientation << endl;
-        } while (!isValidShipPos(g, coord, length, orientation));
-        //cout << "coord: " << coord << endl;
-        g->addShip(shipName, coord, orientation, length);
+        } while (!g->isValidShipPos(row, col, length, orientation));
+        g->addShip(shipName, row, col, orientation, length);
     }
 }
 
-void attack(Grid* g, int row, int col) {
+void attackFleet(SparseGrid* g, int row, int col) {
+    string who = g->isOpponent() ? "You" : "Enemy";
     if (g->getCellStatus(row, col) == OCCUPIED) {
         g->setCellStatus(row, col, DAMAGED);
-        Ship* ship = g->hitShip(row, col);
+        FleetShip* ship = g->hitShip(row, col);
         if (ship == nullptr) {
             cout << "Cell is labeled 'occupied' without any ship occupying it." << endl;
         }
-        else {
-            if (g->isOpponent() == false) {
-                cout << "Enemy fired at " << getLetter(row) << col << " and struck your " << ship->name() << "." << endl;
-                if (ship->hasSunk()) {
-                    cout << "The enemy sank your " << ship->name() << "." << endl;
-                    g->sinkShip(ship);
-                }
+        else if (g->isOpponent() == false) {
+            cout << "Enemy fired at " << rowLabel(row) << col << " and struck your " << ship->name << "." << endl;
+            if (ship->damage == ship->length) {
+                cout << "The enemy sank your " << ship->name << "." << endl;
+                g->sinkShip(ship);
             }
-            else {
-                cout << "You fired at " << getLetter(row) << col << " and struck an enemy ship." << endl;
-                if (ship->hasSunk()) {
-                    cout << "You sank the enemy's " << ship->name() << "." << endl;
-                    g->sinkShip(ship);
-                }
+        }
+        else {
+            cout << "You fired at " << rowLabel(row) << col << " and struck an enemy ship." << endl;
+            if (ship->damage == ship->length) {
+                cout << "You sank the enemy's " << ship->name << "." << endl;
+                g->sinkShip(ship);
             }
         }
     }
     else if (g->getCellStatus(row, col) == EMPTY) {
         g->setCellStatus(row, col, HIT);
-        if (g->isOpponent() == true) {
-            cout << "You fired at " << getLetter(row) << col << " and struck water." << endl;
+        cout << who << " fired at " << rowLabel(row) << col << " and struck water." << endl;
+    }
+    else {
+        cout << "You fired at a location that has been previously targeted. Such a waste of ammunition..." << endl;
+    }
+}
+
+void displayWindow(SparseGrid* g, int row, int col) {
+    int top = max(1, min(row - WINDOW / 2, g->rows() - WINDOW + 1));
+    int left = max(1, min(col - WINDOW / 2, g->cols() - WINDOW + 1));
+    int width = rowLabel(min(top + WINDOW - 1, g->rows())).length();
+    
+    for (int i = top; i < top + WINDOW && i <= g->rows(); i++) {
+        string label = rowLabel(i);
+        cout << string(width - label.length(), ' ') << label << " ";
+        for (int j = left; j < left + WINDOW && j <= g->cols(); j++) {
+            int status = g->getCellStatus(i, j);
+            if (status == DAMAGED) {
+                cout << "X ";
+            }
+            else if (status == HIT) {
+                cout << "  ";
+            }
+            else if (status == OCCUPIED && !g->isOpponent()) {
+                cout << "O ";
+            }
+            else {
+                cout << ". ";
+            }
+        }
+        cout << endl;
+    }
+    cout << string(width + 1, ' ') << "columns " << left << " to " << min(left + WINDOW - 1, g->cols()) << endl;
+}
+
+void playFleetBattle(int rows, int cols, int numShips) {
+    if (rows < 1 || cols < 1 || rows > MAXLARGE || cols > MAXLARGE || numShips < 1) {
+        cout << "***** Fleet battles need 1 to " << MAXLARGE << " rows and columns and at least one ship!" << endl;
+        exit(1);
+    }
+    
+    SparseGrid* player = new SparseGrid(rows, cols, false);
+    SparseGrid* opponent = new SparseGrid(rows, cols, true);
+    addRandomFleet(player, numShips);
+    addRandomFleet(opponent, numShips);
+    
+    cout << "Both fleets of " << numShips << " ships have been deployed on a " << rows << "x" << cols << " map." << endl;
+    
+    string coord;
+    int row = 0;
+    int col = 0;
+    vector<pair<int, int>> leads;
+    
+    while (player->numShips() > 0 && opponent->numShips() > 0) {
+        cout << endl << "Your ships: " << player->numShips() << "   Enemy ships: " << opponent->numShips()
+             << "   Tiles in memory: " << player->numTiles() + opponent->numTiles() << endl;
+        cout << "Enter coordinates: ";
+        if (!getline(cin, coord)) {
+            break;
+        }
+        cout << endl;
+        if (!parseLargeCoord(coord, rows, cols, row, col)) {
+            cout << "You fired at " << coord << ", a location that is not even on the map. Such a waste of ammunition..." << endl;
         }
         else {
-            cout << "Enemy fired at " << getLetter(row) << col << " and struck water." << endl;
+            attackFleet(opponent, row, col);
+            displayWindow(opponent, row, col);
+        }
+        
+          //opponent's turn: follow up on earlier hits, otherwise fire at random
+        row = 0;
+        while (!leads.empty() && row == 0) {
+            pair<int, int> lead = leads.back();
+            leads.pop_back();
+            if (lead.first >= 1 && lead.second >= 1 && lead.first <= rows && lead.second <= cols &&
+                (player->getCellStatus(lead.first, lead.second) == EMPTY || player->getCellStatus(lead.first, lead.second) == OCCUPIED)) {
+                row = lead.first;
+                col = lead.second;
+            }
+        }
+        while (row == 0 || player->getCellStatus(row, col) == HIT || player->getCellStatus(row, col) == DAMAGED) {
+            row = randInt(1, rows);
+            col = randInt(1, cols);
+        }
+        
+        int numShipsBefore = player->numShips();
+        attackFleet(player, row, col);
+        if (player->numShips() != numShipsBefore) {
+            leads.clear();
+        }
+        else if (player->getCellStatus(row, col) == DAMAGED) {
+            leads.push_back(make_pair(row - 1, col));
+            leads.push_back(make_pair(row + 1, col));
+            leads.push_back(make_pair(row, col - 1));
+            leads.push_back(make_pair(row, col + 1));
         }
     }
+    
+    cout << endl << "-----------------------------" << endl;
+    if (opponent->numShips() == 0 && player->numShips() > 0) {
+        cout << "      ***  VICTORY  ***     " << endl;
+    }
+    else if (player->numShips() == 0 && opponent->numShips() > 0) {
+        cout << "      ***  DEFEAT  ***      " << endl;
+    }
     else {
-        cout << "You fired at a location that has been previously targeted. Such a waste of ammunition..." << endl;
+        cout << "The battle was abandoned with " << player->numShips() << " of your ships and " << opponent->numShips() << " enemy ships afloat." << endl;
     }
+    
+    delete player;
+    delete opponent;
 }
 
 
 
 
-int main() {
+int main(int argc, char* argv[]) {
+    int budget = DEFAULTBUDGET;
+    string recordFile = "";
+    PriorTable* priors = nullptr;
+    SpectatorFeed* feed = nullptr;
+    string simulateDir = "";
+    long simulateGames = 0;
+    int workers = max(1, static_cast<int>(thread::hardware_concurrency()));
+    long simulateSamples = 0;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-t" && i + 1 < argc) {
+            budget = atoi(argv[++i]);
+        }
+        else if (arg == "-r" && i + 1 < argc) {
+            recordFile = argv[++i];
+        }
+        else if (arg == "-priors" && i + 1 < argc) {
+            priors = new PriorTable();
+            if (!loadPriors(argv[++i], *priors)) {
+                return 1;
+            }
+        }
+        else if (arg == "-feed" && i + 1 < argc) {
+            feed = new SpectatorFeed(argv[++i]);
+            if (!feed->isOpen()) {
+                return 1;
+            }
+        }
+        else if (arg == "-spectate" && i + 1 < argc) {
+            spectate(argv[i + 1]);
+            return 0;
+        }
+        else if (arg == "-feedbench" && i + 1 < argc) {
+            benchFeed(atoi(argv[i + 1]));
+            return 0;
+        }
+        else if (arg == "-train" && i + 2 < argc) {
+            trainPriors(argv[i + 1], vector<string>(argv + i + 2, argv + argc));
+            return 0;
+        }
+        else if (arg == "-evaluate" && i + 2 < argc) {
+            evaluatePriors(argv[i + 1], vector<string>(argv + i + 2, argv + argc), simulateSamples > 0 ? simulateSamples : EVALSAMPLES);
+            return 0;
+        }
+        else if (arg == "-analyze" && i + 1 < argc) {
+            analyzeRecords(vector<string>(argv + i + 1, argv + argc));
+            return 0;
+        }
+        else if (arg == "-simulate" && i + 2 < argc) {
+            simulateDir = argv[++i];
+            simulateGames = atol(argv[++i]);
+        }
+        else if (arg == "-workers" && i + 1 < argc) {
+            workers = max(1, atoi(argv[++i]));
+        }
+        else if (arg == "-samples" && i + 1 < argc) {
+            simulateSamples = max(0L, atol(argv[++i]));
+        }
+        else if (arg == "-merge" && i + 1 < argc) {
+            mergeShards(argv[i + 1]);
+            return 0;
+        }
+        else if (arg == "-ffa" && i + 1 < argc) {
+            int numPlayers = atoi(argv[i + 1]);
+            if (numPlayers < 2 || numPlayers > MAXPLAYERS) {
+                cout << "***** A free-for-all needs 2 to " << MAXPLAYERS << " players!" << endl;
+                return 1;
+            }
+            default_random_engine generator(random_device{}());
+            long rounds = 0;
+            long shotsFired = 0;
+            double seconds = 0;
+            playFfa(numPlayers, true, generator, rounds, shotsFired, seconds);
+            return 0;
+        }
+        else if (arg == "-ffabench") {
+            benchFfa();
+            return 0;
+        }
+        else if (arg == "-fleet" && i + 3 < argc) {
+            playFleetBattle(atoi(argv[i + 1]), atoi(argv[i + 2]), atoi(argv[i + 3]));
+            return 0;
+        }
+        else {
+            cout << "Usage: " << argv[0] << " [-t microseconds] [-r file] [-priors file] [-feed name] [-spectate name] [-feedbench readers] [-ffa players] [-ffabench] [-simulate dir games] [-workers n] [-samples n] [-merge dir] [-fleet rows cols ships] [-analyze file...] [-train priors file...] [-evaluate priors file...]" << endl;
+            cout << "  -t          time the enemy may think per move (default " << DEFAULTBUDGET << ", 0 for the classic AI)" << endl;
+            cout << "  -r          append a record of the game to file" << endl;
+            cout << "  -priors     let the enemy expect placements learned with -train" << endl;
+            cout << "  -feed       let other processes watch the game under this name" << endl;
+            cout << "  -spectate   watch a game started with -feed" << endl;
+            cout << "  -feedbench  time publishing frames with this many reader processes" << endl;
+            cout << "  -ffa        free-for-all against up to " << MAXPLAYERS - 1 << " computer fleets" << endl;
+            cout << "  -ffabench   time free-for-all rounds from 2 to " << MAXPLAYERS << " computer fleets" << endl;
+            cout << "  -simulate   play games between the enemy AI and random fleets, resumable" << endl;
+            cout << "  -workers    processes for -simulate (default one per core)" << endl;
+            cout << "  -samples    let -simulate use the sampling enemy with this many layouts per shot (default 0, the classic AI)" << endl;
+            cout << "              and set the layouts per shot for -evaluate (default " << EVALSAMPLES << ")" << endl;
+            cout << "  -merge      merge the shards of a -simulate run into one record file" << endl;
+            cout << "  -fleet      fleet battle on a large map, e.g. -fleet 1000 1000 5000" << endl;
+            cout << "  -analyze    statistics over recorded games" << endl;
+            cout << "  -train      learn placement priors from recorded games" << endl;
+            cout << "  -evaluate   compare shots to win with and without priors on held-out recorded games" << endl;
+            return 1;
+        }
+    }
+    if (simulateDir != "") {
+        simulate(simulateDir, simulateGames, workers, simulateSamples, priors);
+        return 0;
+    }
+    
     cout << "-----------------------------" << endl << "*** WELCOME TO BATTLESHIP ***" << endl << "-----------------------------" << endl << endl;
     Grid* player = new Grid(false);
     
@@ -690,19 +3018,44 @@ int main() {
     Grid* opponent = new Grid(true);
     addOppShips(opponent);
     
+    GameRecord record;
+    recordLayout(player, record);
+    
     int row = 0;
     int col = 0;
-    
-    bool findDirection = false;
-    int setDirection = -1;
-    int dir = -1;
+    HuntAI hunter(random_device{}());
+    int turn = 0;
     
     //starting round...
     while (player->numShips() > 0 && opponent->numShips() > 0) {
         display(player, opponent);
         cout << endl;
-        cout << "Enter coordinates: ";
+        turn++;
+        if (feed != nullptr) {
+            feed->publish(player, opponent, turn);
+        }
+        
+          // Neither board changes while the player types, so the enemy can work out its move in the meantime
+        Targeter enemyTargeter(player, priors);
+        Targeter hintTargeter(opponent);
+        Ponderer ponderer(&enemyTargeter, budget);
+        if (budget > 0) {
+            ponderer.start();
+        }
+        
+        cout << (budget > 0 ? "Enter coordinates (or \"hint\"): " : "Enter coordinates: ");
         getline(cin, coord);
+        while (budget > 0 && cin && (coord == "hint" || coord == "Hint")) {
+            int hintRow = 0;
+            int hintCol = 0;
+            ponderer.stop();
+            hintTargeter.run(chrono::steady_clock::now() + chrono::microseconds(budget));
+            hintTargeter.bestTarget(hintRow, hintCol);
+            ponderer.start();
+            cout << "An enemy ship is most likely at " << getLetter(hintRow) << hintCol << "." << endl;
+            cout << "Enter coordinates: ";
+            getline(cin, coord);
+        }
         cout << endl;
         if (!isValidCoord(coord)) {
             cout << "You fired at " << coord << ", a location that is not even on the map. Such a waste of ammunition..." << endl;
@@ -712,102 +3065,29 @@ int main() {
         }
         
         //opponent's turn
-        string randCoord;
-        
-        int tempRow = row;
-        int tempCol = col;
-        
-        if (!findDirection && setDirection == -1) {
-            do {
-                row = randInt(1, MAXCOLS);
-                col = randInt(1, MAXCOLS);
-                randCoord = getLetter(row) + to_string(col);
-            } while (!isValidCoord(randCoord) || player->getCellStatus(row, col) == HIT || player->getCellStatus(row, col) == DAMAGED);
-        }
-        else if (setDirection != -1) {
-            do {
-                switch (setDirection) {
-                    case NORTH: row--; break;
-                    case EAST: col++; break;
-                    case SOUTH: row++; break;
-                    case WEST: col--; break;
-                    default: cout << "Problem when setDirection != -1" << endl; break;
-                }
-                randCoord = getLetter(row) + to_string(col);
-                
-                if (!isValidCoord(randCoord) || player->getCellStatus(row, col) == HIT) {
-                    switch (setDirection) {
-                        case NORTH: setDirection = SOUTH; row++; break;
-                        case EAST: setDirection = WEST; col--; break;
-                        case SOUTH: setDirection = NORTH; row--; break;
-                        case WEST: setDirection = EAST; col++; break;
-                        default: cout << "Problem when not valid and hit" << endl; break;
-                    }
-                }
-                 
-            } while (!isValidCoord(randCoord) || player->getCellStatus(row, col) == HIT || player->getCellStatus(row, col) == DAMAGED);
-        }
-        else if (findDirection){
-            do {
-                int n = randInt(1, 4);
-                row = tempRow;
-                col = tempCol;
-                
-                switch (n) {
-                    case 1: dir = NORTH; row--; break;
-                    case 2: dir = EAST; col++; break;
-                    case 3: dir = SOUTH; row++; break;
-                    case 4: dir = WEST; col--; break;
-                    default: dir = NORTH; break;
-                }
-                randCoord = getLetter(row) + to_string(col);
-            } while (!isValidCoord(randCoord) || player->getCellStatus(row, col) == HIT || player->getCellStatus(row, col) == DAMAGED);
+        if (budget > 0) {
+            ponderer.finish();
+            enemyTargeter.bestTarget(row, col);
         }
         else {
-            cout << "There is a problem here..." << endl;
+            hunter.nextShot(player, row, col);
         }
         
         int numShips = player->numShips();
+        record.shots[record.numShots++] = (row - 1) * MAXCOLS + col - 1;
         attack(player, row, col);
-        
-        if (player->getCellStatus(row, col) == DAMAGED && findDirection) {
-            findDirection = false;
-            switch (dir) {
-                case NORTH: setDirection = NORTH; break;
-                case EAST: setDirection = EAST; break;
-                case SOUTH: setDirection = SOUTH; break;
-                case WEST: setDirection = WEST; break;
-                default: cout << "Issue with 'DAMAGED' and 'findDirection'" << endl; break;
-            }
-        }
-        else if (player->getCellStatus(row, col) == DAMAGED) {
-            findDirection = true;
-        }
-        else if (player->getCellStatus(row, col) != DAMAGED && findDirection) {
-            switch (dir) {
-                case NORTH: row++; break;
-                case EAST: col--; break;
-                case SOUTH: row--; break;
-                case WEST: col++; break;
-                default: cout << "Issue with !'DAMAGED' and 'findDirection'" << endl; break;
-            }
-        }
-        else if (player->getCellStatus(row, col) == HIT && setDirection != -1) {
-            switch (setDirection) {
-                case NORTH: setDirection = SOUTH; break;
-                case EAST: setDirection = WEST; break;
-                case SOUTH: setDirection = NORTH; break;
-                case WEST: setDirection = EAST; break;
-                default: cout << "Issue with 'HIT' and 'setDirection'" << endl; break;
-            }
-        }
-        
-        if (player->numShips() != numShips) {
-            findDirection = false;
-            setDirection = -1;
+        if (budget == 0) {
+            hunter.observe(player, player->numShips() != numShips);
         }
     }
     display(player, opponent);
+    if (recordFile != "") {
+        appendRecord(recordFile, record);
+    }
+    if (feed != nullptr) {
+        feed->publish(player, opponent, turn + 1);
+        delete feed;
+    }
     cout << endl << "-----------------------------" << endl;
     
     if (player->numShips() == 0 && opponent->numShips() == 0) {